@@ -0,0 +1,194 @@
+#include "dec.hpp"
+
+// What calling each subroutine does (m8b_call_effect), kept in the helper
+// netnode: whether it comes back, the registers it writes and how deep it
+// takes the stacks. create_code() has the whole call graph summarized
+// bottom-up before the first instruction is created, so emu() knows at every
+// CALL whether the code flows on. Functions propagate() revisits are walked
+// again over the database, and their callers after them if the effect changed.
+#define TAG_EFFECT  'C'         // m8b_call_effect at a subroutine start
+#define NODEPTH     (-0x10000)
+#define MAXUPDATES  0x400       // functions walked per run
+
+static qvector<ea_t> qvActive;  // functions being walked, to catch recursion
+
+static const m8b_call_effect* get_callee_effect(ea_t ea, m8b_call_effect* pEffect);
+static void walk_function(ea_t eaFunc, m8b_call_effect* pEffect);
+
+size_t store_call_effects(const m8b_decoder* pDecoder, const uint8* rgbFlags)
+{
+    qvector<m8b_call_effect> qvEffects;
+    qvector<uint16> qveaWork;
+    segment_t* pSegment;
+    size_t off, nFuncs;
+
+    pSegment = segROM();
+    if (!pSegment) return 0;
+
+    qvEffects.resize(pDecoder->cbROM);
+    qveaWork.resize(3 * pDecoder->cbROM);
+    nFuncs = m8b_summarize(pDecoder, rgbFlags, qvEffects.begin(), qveaWork.begin());
+
+    for (off = 0; off < pDecoder->cbROM; ++off)
+    {
+        if (qvEffects[off].flags & M8B_CE_DONE)
+            helper.supset(pSegment->startEA + off, &qvEffects[off], sizeof(m8b_call_effect), TAG_EFFECT);
+    }
+    return nFuncs;
+}
+
+bool get_call_effect(ea_t ea, m8b_call_effect* pEffect)
+{
+    if (helper.supval(ea, pEffect, sizeof(*pEffect), TAG_EFFECT) == sizeof(*pEffect))
+        return true;
+
+    memset(pEffect, 0, sizeof(*pEffect));
+    return false;
+}
+
+// IDA decides for subroutines without an effect
+bool call_returns(ea_t ea)
+{
+    m8b_call_effect effect;
+
+    if (get_call_effect(ea, &effect))
+        return !(effect.flags & M8B_CE_NORETURN);
+    return func_does_return(ea);
+}
+
+// Walk the changed functions again. A caller follows when an effect changed,
+// and its CALLs go back to emu() if the callee stopped or started returning.
+void update_call_effects(const qvector<ea_t>& qvFuncs)
+{
+    qvector<ea_t> qvWork;
+    m8b_call_effect effect, old;
+    m8b_insn insn;
+    func_t* pFunc;
+    size_t nSteps;
+    ea_t ea, eaFrom;
+
+    qvWork = qvFuncs;
+    for (nSteps = 0; !qvWork.empty() && nSteps < MAXUPDATES; ++nSteps)
+    {
+        ea = qvWork.back();
+        qvWork.pop_back();
+        pFunc = get_func(ea);
+        if (!pFunc || pFunc->startEA != ea) continue;
+
+        walk_call_effect(ea, &effect);
+        if (get_call_effect(ea, &old) && !memcmp(&old, &effect, sizeof(effect)))
+            continue;
+        helper.supset(ea, &effect, sizeof(effect), TAG_EFFECT);
+
+        for (eaFrom = get_first_fcref_to(ea); eaFrom != BADADDR; eaFrom = get_next_fcref_to(ea, eaFrom))
+        {
+            if (!decode_rom(eaFrom, &insn) || insn.itype != M8B_CALL)
+                continue;
+
+            if ((old.flags ^ effect.flags) & M8B_CE_NORETURN)
+                auto_mark_range(eaFrom, eaFrom + insn.size, AU_USED);
+
+            pFunc = get_func(eaFrom);
+            if (pFunc) qvWork.add_unique(pFunc->startEA);
+        }
+    }
+}
+
+// The effect of the function at ea as the database has it now
+void walk_call_effect(ea_t ea, m8b_call_effect* pEffect)
+{
+    qvActive.push_back(ea);
+    walk_function(ea, pEffect);
+    qvActive.pop_back();
+}
+
+// What a CALL to ea does, NULL if that can not be known. Code IDA found after
+// create_code() has no effect yet and is walked and stored first.
+static const m8b_call_effect* get_callee_effect(ea_t ea, m8b_call_effect* pEffect)
+{
+    size_t i;
+
+    if (ea == BADADDR) return NULL;
+
+    for (i = 0; i < qvActive.size(); ++i)
+    {
+        if (qvActive[i] == ea)
+        {
+            memset(pEffect, 0, sizeof(*pEffect));
+            pEffect->flags = M8B_CE_ACTIVE;
+            return pEffect;
+        }
+    }
+
+    if (get_call_effect(ea, pEffect)) return pEffect;
+    if (!isCode(getFlags(ea))) return NULL;
+
+    walk_call_effect(ea, pEffect);
+    helper.supset(ea, pEffect, sizeof(*pEffect), TAG_EFFECT);
+    return pEffect;
+}
+
+// m8b_summarize() over the database: the code IDA has and its code xrefs
+static void walk_function(ea_t eaFunc, m8b_call_effect* pEffect)
+{
+    qvector<int> qvDepth;       // ROM offset to depth before the instruction
+    qvector<ea_t> qvWork;
+    const m8b_call_effect* pCallee;
+    m8b_call_effect callee;
+    segment_t* pSegment;
+    m8b_insn insn;
+    ea_t ea, eaTo;
+    int nDepth;
+    bool fFlow;
+
+    m8b_effect_init(pEffect);
+    pSegment = segROM();
+    if (!pSegment || !pSegment->contains(eaFunc))
+    {
+        pEffect->flags |= M8B_CE_PARTIAL;
+        m8b_effect_done(pEffect);
+        return;
+    }
+
+    qvDepth.resize(pSegment->endEA - pSegment->startEA, NODEPTH);
+    qvDepth[eaFunc - pSegment->startEA] = 0;
+    qvWork.push_back(eaFunc);
+
+    while (!qvWork.empty())
+    {
+        ea = qvWork.back();
+        qvWork.pop_back();
+        if (!isCode(getFlags(ea)) || !decode_rom(ea, &insn))
+        {
+            pEffect->flags |= M8B_CE_PARTIAL;
+            continue;
+        }
+
+        eaTo = insn.itype == M8B_CALL ? toROM(insn.addr) : BADADDR;
+        pCallee = eaTo != BADADDR ? get_callee_effect(eaTo, &callee) : NULL;
+        nDepth = qvDepth[ea - pSegment->startEA];
+        fFlow = m8b_effect_step(pEffect, &insn, pCallee, &nDepth);
+        if (pEffect->flags & M8B_CE_UNBOUNDED) break;
+
+        // IDA decides whether a callee that is not code comes back
+        if (eaTo != BADADDR && !pCallee) fFlow = func_does_return(eaTo);
+        if (fFlow && ea + insn.size < pSegment->endEA && nDepth > qvDepth[ea + insn.size - pSegment->startEA])
+        {
+            qvDepth[ea + insn.size - pSegment->startEA] = nDepth;
+            qvWork.push_back(ea + insn.size);
+        }
+
+        if (insn.itype == M8B_CALL) continue;
+        for (eaTo = get_first_fcref_from(ea); eaTo != BADADDR; eaTo = get_next_fcref_from(ea, eaTo))
+        {
+            if (eaTo < pSegment->startEA || eaTo >= pSegment->endEA) continue;
+            if (nDepth > qvDepth[eaTo - pSegment->startEA])
+            {
+                qvDepth[eaTo - pSegment->startEA] = nDepth;
+                qvWork.push_back(eaTo);
+            }
+        }
+    }
+
+    m8b_effect_done(pEffect);
+}
@@ -0,0 +1,338 @@
+#include "dec.hpp"
+
+void m8b_init(m8b_decoder* pDecoder, const uint8* pbROM, size_t cbROM)
+{
+    pDecoder->pbROM = pbROM;
+    pDecoder->cbROM = cbROM;
+}
+
+// Decode the instruction at ea. Returns its size or 0 if the opcode is invalid
+// or the instruction runs past the end of the ROM.
+size_t m8b_decode(const m8b_decoder* pDecoder, size_t ea, m8b_insn* pInsn)
+{
+    if (ea >= pDecoder->cbROM)
+    {
+        m8b_decode_bytes(ea, NULL, 0, pInsn);
+        return 0;
+    }
+
+    return m8b_decode_bytes(ea, pDecoder->pbROM + ea, pDecoder->cbROM - ea, pInsn);
+}
+
+// Decode the cbCode bytes at pbCode as the instruction at ROM offset ea
+size_t m8b_decode_bytes(size_t ea, const uint8* pbCode, size_t cbCode, m8b_insn* pInsn)
+{
+    const opcode_desc* pOpcode;
+    uint8 code;
+
+    pInsn->ea = (uint16)ea;
+    pInsn->code = 0;
+    pInsn->itype = M8B_null;
+    pInsn->size = 0;
+    pInsn->value = 0;
+    pInsn->addr = 0;
+
+    if (!cbCode)
+        return 0;
+
+    code = pbCode[0];
+    pOpcode = rgOpcodes + code;
+    pInsn->code = code;
+
+    if (pOpcode->itype == M8B_null || pOpcode->size > cbCode)
+        return 0;
+
+    pInsn->itype = pOpcode->itype;
+    pInsn->size = pOpcode->size;
+
+    if (pOpcode->size > 1)
+    {
+        pInsn->value = pbCode[1];
+        pInsn->addr = pInsn->value;
+
+        switch (pOpcode->op1)
+        {
+        case opk_near:
+            pInsn->addr = (uint16)((ea & 0xF000) | ((code & 0xF) << 8) | pInsn->value);
+            break;
+        case opk_near1:
+            pInsn->addr = (uint16)((ea & 0xF000) | ((code & 0xF) << 8) | pInsn->value | 0x1000);
+            break;
+        }
+    }
+
+    return pOpcode->size;
+}
+
+// Linear sweep over [eaStart, eaEnd). Every byte that does not start a valid
+// instruction yields a record with size 0 and the sweep continues with the next
+// byte. Returns the number of records written.
+size_t m8b_decode_all(const m8b_decoder* pDecoder, size_t eaStart, size_t eaEnd, m8b_insn* rgInsns, size_t nInsns)
+{
+    size_t ea, n, size;
+
+    if (eaEnd > pDecoder->cbROM)
+        eaEnd = pDecoder->cbROM;
+
+    for (ea = eaStart, n = 0; ea < eaEnd && n < nInsns; ++n)
+    {
+        size = m8b_decode(pDecoder, ea, rgInsns + n);
+        ea += size ? size : 1;
+    }
+
+    return n;
+}
+
+// The references emu() adds for an instruction. Returns their number.
+size_t m8b_xrefs(const m8b_insn* pInsn, m8b_ref rgRefs[M8B_MAXREFS])
+{
+    const opcode_desc* pOpcode;
+    uint32 dwFeature;
+    size_t n = 0;
+    uint8 kind;
+
+    if (!pInsn->size)
+        return 0;
+
+    pOpcode = rgOpcodes + pInsn->code;
+    dwFeature = rgInstructions[pInsn->itype].feature;
+    kind = pOpcode->op1 == opk_A ? pOpcode->op2 : pOpcode->op1;
+
+    switch (kind)
+    {
+    case opk_near:
+    case opk_near1:
+        rgRefs[n].to = pInsn->addr;
+        rgRefs[n].type = pInsn->itype == M8B_INDEX ? rt_table : (dwFeature & CF_CALL) ? rt_call : rt_jump;
+        rgRefs[n].fWrite = 0;
+        ++n;
+        break;
+    case opk_mem:
+    case opk_displ:
+        switch (pInsn->itype)
+        {
+        case M8B_IORD:
+        case M8B_IOWR:
+        case M8B_IOWX:
+        case M8B_IPRET:
+            rgRefs[n].type = rt_io;
+            rgRefs[n].fWrite = pInsn->itype != M8B_IORD;
+            break;
+        default:
+            rgRefs[n].type = rt_ram;
+            rgRefs[n].fWrite = kind == pOpcode->op1 && (dwFeature & CF_CHG1) != 0;
+        }
+        rgRefs[n].to = pInsn->value;
+        ++n;
+        break;
+    }
+
+    if (!(dwFeature & CF_STOP))
+    {
+        rgRefs[n].to = (uint16)(pInsn->ea + pInsn->size);
+        rgRefs[n].type = rt_flow;
+        rgRefs[n].fWrite = 0;
+        ++n;
+    }
+
+    return n;
+}
+
+// ROM offset a JACC or INDEX at table addr reaches with A. The sum carries
+// into the next page, as in the core; a 12 bit address plus A stays in 13 bits.
+uint16 m8b_table_addr(uint16 addr, uint8 a)
+{
+    return (uint16)(addr + a);
+}
+
+// Turn the register values known before pInsn into those known after it.
+// Anything loaded from RAM or the data stack is unknown, and so is everything
+// after a CALL; callers with subroutine summaries handle CALL themselves.
+void m8b_track(m8b_regstate* pState, const m8b_insn* pInsn)
+{
+    const opcode_desc* pOpcode = rgOpcodes + pInsn->code;
+    bool fA = (pState->flags & M8B_RS_A) != 0;
+    bool fX = (pState->flags & M8B_RS_X) != 0;
+    bool fDSP = (pState->flags & M8B_RS_DSP) != 0;
+    uint8 a = pState->a, x = pState->x, dsp = pState->dsp, psp = pState->psp, imm = pInsn->value;
+    uint8 flags = pState->flags;
+
+    if (!pInsn->size)
+    {
+        pState->flags = 0;
+        return;
+    }
+
+    switch (pInsn->itype)
+    {
+    case M8B_MOV:
+        if (pOpcode->op1 == opk_A)
+        {
+            flags &= ~(M8B_RS_A | M8B_RS_APORT);
+            if (pOpcode->op2 == opk_imm) { flags |= M8B_RS_A; a = imm; }
+            else if (pOpcode->op2 == opk_X && fX) { flags |= M8B_RS_A; a = x; }
+        }
+        else if (pOpcode->op1 == opk_X)
+        {
+            flags &= ~M8B_RS_X;
+            if (pOpcode->op2 == opk_imm) { flags |= M8B_RS_X; x = imm; }
+            else if (pOpcode->op2 == opk_A && fA) { flags |= M8B_RS_X; x = a; }
+        }
+        else if (pOpcode->op1 == opk_PSP)
+        {
+            flags &= ~M8B_RS_PSP;
+            if (fA) { flags |= M8B_RS_PSP; psp = a; }
+        }
+        break;
+    case M8B_ADD:
+    case M8B_SUB:
+    case M8B_AND:
+    case M8B_OR:
+    case M8B_XOR:
+        if (pOpcode->op1 != opk_A)
+            break;
+
+        flags &= ~(M8B_RS_A | M8B_RS_APORT);
+        if (pOpcode->op2 == opk_imm && fA)
+        {
+            flags |= M8B_RS_A;
+            switch (pInsn->itype)
+            {
+            case M8B_ADD: a += imm; break;
+            case M8B_SUB: a -= imm; break;
+            case M8B_AND: a &= imm; break;
+            case M8B_OR:  a |= imm; break;
+            case M8B_XOR: a ^= imm; break;
+            }
+        }
+        break;
+    case M8B_INC:
+    case M8B_DEC:
+        if (pOpcode->op1 == opk_A)
+        {
+            flags &= ~M8B_RS_APORT;
+            a += pInsn->itype == M8B_INC ? 1 : -1;
+        }
+        else if (pOpcode->op1 == opk_X)
+            x += pInsn->itype == M8B_INC ? 1 : -1;
+        break;
+    case M8B_CPL:
+        flags &= ~M8B_RS_APORT;
+        a = ~a;
+        break;
+    case M8B_ASL:
+        flags &= ~M8B_RS_APORT;
+        a <<= 1;
+        break;
+    case M8B_ASR:
+        flags &= ~M8B_RS_APORT;
+        a = (uint8)((a >> 1) | (a & 0x80));
+        break;
+    case M8B_IORD:
+        flags = (flags & ~(M8B_RS_A | M8B_RS_APORT)) | M8B_RS_APORT;
+        a = imm;
+        pState->eaRead = pInsn->ea;
+        break;
+    case M8B_SWAP:
+        if (pOpcode->op2 == opk_X)
+        {
+            flags &= ~(M8B_RS_A | M8B_RS_X | M8B_RS_APORT);
+            if (fX) flags |= M8B_RS_A;
+            if (fA) flags |= M8B_RS_X;
+            a = pState->x;
+            x = pState->a;
+        }
+        else
+        {
+            flags &= ~(M8B_RS_A | M8B_RS_APORT | M8B_RS_DSP);
+            if (fDSP) flags |= M8B_RS_A;
+            if (fA) flags |= M8B_RS_DSP;
+            a = pState->dsp;
+            dsp = pState->a;
+        }
+        break;
+    case M8B_ADC:
+    case M8B_SBB:
+    case M8B_RLC:
+    case M8B_RRC:
+    case M8B_INDEX:
+        if (pOpcode->op1 == opk_A || pInsn->itype == M8B_INDEX)
+            flags &= ~(M8B_RS_A | M8B_RS_APORT);
+        break;
+    case M8B_PUSH:
+        --dsp;
+        break;
+    case M8B_POP:
+        flags &= pOpcode->op1 == opk_A ? ~(M8B_RS_A | M8B_RS_APORT) : ~M8B_RS_X;
+        ++dsp;
+        break;
+    case M8B_CALL:
+        flags = 0;
+        break;
+    }
+
+    pState->flags = flags;
+    pState->a = a;
+    pState->x = x;
+    pState->dsp = dsp;
+    pState->psp = psp;
+}
+
+static uint8 reg_bits(uint8 kind)
+{
+    switch (kind)
+    {
+    case opk_A:   return M8B_RS_A | M8B_RS_APORT;
+    case opk_X:   return M8B_RS_X;
+    case opk_DSP: return M8B_RS_DSP;
+    case opk_PSP: return M8B_RS_PSP;
+    }
+
+    return 0;
+}
+
+// Registers pInsn may change (M8B_RS_xxx). A CALL changes whatever the
+// subroutine changes, so it reports all of them.
+uint8 m8b_writes(const m8b_insn* pInsn)
+{
+    const opcode_desc* pOpcode = rgOpcodes + pInsn->code;
+
+    switch (pInsn->itype)
+    {
+    case M8B_null:
+    case M8B_CMP:
+        return 0;
+    case M8B_IORD:
+    case M8B_INDEX:
+        return M8B_RS_A | M8B_RS_APORT;
+    case M8B_PUSH:
+        return M8B_RS_DSP;
+    case M8B_POP:
+        return M8B_RS_DSP | reg_bits(pOpcode->op1);
+    case M8B_SWAP:
+        return reg_bits(pOpcode->op1) | reg_bits(pOpcode->op2);
+    case M8B_CALL:
+        return M8B_RS_ALL;
+    }
+
+    return (rgInstructions[pInsn->itype].feature & CF_CHG1) ? reg_bits(pOpcode->op1) : 0;
+}
+
+// Merge the values known on another path into pState: only values known and
+// equal on both survive. Returns true if pState changed.
+bool m8b_meet(m8b_regstate* pState, const m8b_regstate* pOther)
+{
+    uint8 flags = pState->flags & pOther->flags;
+
+    if ((flags & M8B_RS_A) && pState->a != pOther->a) flags &= ~M8B_RS_A;
+    if ((flags & M8B_RS_APORT) && (pState->a != pOther->a || pState->eaRead != pOther->eaRead)) flags &= ~M8B_RS_APORT;
+    if ((flags & M8B_RS_X) && pState->x != pOther->x) flags &= ~M8B_RS_X;
+    if ((flags & M8B_RS_DSP) && pState->dsp != pOther->dsp) flags &= ~M8B_RS_DSP;
+    if ((flags & M8B_RS_PSP) && pState->psp != pOther->psp) flags &= ~M8B_RS_PSP;
+
+    if (flags == pState->flags)
+        return false;
+
+    pState->flags = flags;
+    return true;
+}
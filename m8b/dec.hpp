@@ -0,0 +1,139 @@
+#ifndef DEC_HPP_INCLUDED
+#define DEC_HPP_INCLUDED
+
+#ifdef __IDP__
+#include "m8b.hpp"
+#else
+#include "nosdk.hpp"
+#include "ins.hpp"
+#include "opc.hpp"
+#endif
+
+// Decoded instruction. Records are 8 bytes so a whole ROM fits in a flat array.
+typedef struct m8b_insn_t
+{
+    uint16 ea;          // ROM offset of the instruction
+    uint8 code;         // opcode byte, index into rgOpcodes
+    uint8 itype;        // instructno_t, M8B_null if invalid
+    uint8 size;         // length in bytes, 0 if invalid or truncated
+    uint8 value;        // operand byte (expr, [expr], [X+expr] or low address byte)
+    uint16 addr;        // target of JMP/Jcc/CALL/JACC/INDEX, otherwise value
+}
+m8b_insn;
+
+CASSERT(sizeof(m8b_insn) == 8);
+
+// Decoder state. Nothing is shared between contexts, so any number of them can
+// decode in parallel.
+typedef struct m8b_decoder_t
+{
+    const uint8* pbROM;
+    size_t cbROM;
+}
+m8b_decoder;
+
+// Reference kinds, mirroring the xrefs emu() creates
+enum m8b_reftype_t ENUM_SIZE(uint8)
+{
+    rt_flow = 0,        // ordinary flow to the next instruction
+    rt_jump,            // JMP/Jcc/JACC target
+    rt_call,            // CALL target
+    rt_table,           // INDEX table read
+    rt_ram,             // RAM operand
+    rt_io               // I/O port operand
+};
+
+typedef struct m8b_ref_t
+{
+    uint16 to;          // ROM offset, RAM or I/O address
+    uint8 type;         // m8b_reftype_t
+    uint8 fWrite;       // operand is written (RAM and I/O only)
+}
+m8b_ref;
+
+#define M8B_MAXREFS 2
+
+typedef void (*m8b_ref_cb)(void* pvContext, const m8b_insn* pInsn, const m8b_ref* pRef);
+
+// Byte flags of a recursive descent (m8b_descend)
+#define M8B_DF_CODE   0x01  // first byte of an instruction
+#define M8B_DF_TAIL   0x02  // operand byte of an instruction
+#define M8B_DF_ENTRY  0x04  // one of the roots
+#define M8B_DF_JUMP   0x08  // target of a jump or JACC
+#define M8B_DF_CASE   0x10  // entry of a JACC table
+#define M8B_DF_CALL   0x20  // target of a CALL
+#define M8B_DF_TABLE  0x40  // INDEX table
+#define M8B_DF_JACC   0x80  // start of a JACC table
+
+// Register values known before or after an instruction (m8b_track)
+#define M8B_RS_A      0x01  // A holds a
+#define M8B_RS_X      0x02  // X holds x
+#define M8B_RS_APORT  0x04  // A holds what the IORD at eaRead read from port a
+#define M8B_RS_DSP    0x08  // DSP holds dsp
+#define M8B_RS_PSP    0x10  // PSP holds psp
+#define M8B_RS_ALL    (M8B_RS_A|M8B_RS_X|M8B_RS_APORT|M8B_RS_DSP|M8B_RS_PSP)
+
+typedef struct m8b_regstate_t
+{
+    uint8 flags;        // M8B_RS_xxx
+    uint8 a;
+    uint8 x;
+    uint8 dsp;
+    uint8 psp;
+    uint8 reserved;
+    uint16 eaRead;      // ROM offset of the IORD for M8B_RS_APORT
+}
+m8b_regstate;
+
+CASSERT(sizeof(m8b_regstate) == 8);
+
+// What calling a subroutine does to the flow, the stacks and the registers
+// (m8b_summarize). Depths count from the entry: PSP the bytes of return
+// addresses above the caller's, DSP the bytes pushed. Every walker builds one
+// with m8b_effect_init/step/done.
+#define M8B_CE_DONE       0x01  // summarized
+#define M8B_CE_NORETURN   0x02  // no RET, RETI or IPRET is reached
+#define M8B_CE_UNBOUNDED  0x04  // recursion, or pushes in a loop
+#define M8B_CE_PARTIAL    0x08  // some of its code could not be followed
+#define M8B_CE_EI         0x10  // enables interrupts other than by returning
+#define M8B_CE_RESET      0x20  // sets up a new stack (MOV PSP,A or SWAP A,DSP)
+#define M8B_CE_UNEVEN     0x40  // returns at different data stack depths, nNet is the deepest
+#define M8B_CE_ACTIVE     0x80  // being summarized, a CALL to it is recursion
+
+#define M8B_MAXDEPTH      0x80  // a stack deeper than half the RAM never came back down
+#define M8B_NONET         (-0x80)   // nNet while no return was reached
+
+typedef struct m8b_call_effect_t
+{
+    uint8 flags;        // M8B_CE_xxx
+    uint8 fWrites;      // M8B_RS_xxx it and its callees may change
+    uint8 nPSP;         // deepest program stack
+    uint8 nDSP;         // deepest data stack
+    int8 nNet;          // data stack change on return (IPRET pops A)
+    uint8 reserved[3];
+}
+m8b_call_effect;
+
+CASSERT(sizeof(m8b_call_effect) == 8);
+
+void m8b_init(m8b_decoder* pDecoder, const uint8* pbROM, size_t cbROM);
+size_t m8b_decode(const m8b_decoder* pDecoder, size_t ea, m8b_insn* pInsn);
+size_t m8b_decode_bytes(size_t ea, const uint8* pbCode, size_t cbCode, m8b_insn* pInsn);
+size_t m8b_decode_all(const m8b_decoder* pDecoder, size_t eaStart, size_t eaEnd, m8b_insn* rgInsns, size_t nInsns);
+
+size_t m8b_xrefs(const m8b_insn* pInsn, m8b_ref rgRefs[M8B_MAXREFS]);
+uint16 m8b_table_addr(uint16 addr, uint8 a);
+void m8b_track(m8b_regstate* pState, const m8b_insn* pInsn);
+uint8 m8b_writes(const m8b_insn* pInsn);
+bool m8b_meet(m8b_regstate* pState, const m8b_regstate* pOther);
+
+size_t m8b_descend(const m8b_decoder* pDecoder, const uint16* rgeaRoots, size_t nRoots, uint8* rgbFlags, uint16* rgeaWork, m8b_ref_cb pfnRef, void* pvContext);
+size_t m8b_summarize(const m8b_decoder* pDecoder, const uint8* rgbFlags, m8b_call_effect* rgEffects, uint16* rgeaWork);
+void m8b_effect_init(m8b_call_effect* pEffect);
+bool m8b_effect_step(m8b_call_effect* pEffect, const m8b_insn* pInsn, const m8b_call_effect* pCallee, int* pnDepth);
+void m8b_effect_done(m8b_call_effect* pEffect);
+
+size_t m8b_render(const m8b_insn* pInsn, char* szLine, size_t cchLine);
+size_t m8b_render_operand(const m8b_insn* pInsn, size_t n, char* szOperand, size_t cchOperand);
+
+#endif
@@ -0,0 +1,423 @@
+#include "dec.hpp"
+#include <string.h>
+
+#define MAXCASES 128    // JACC reaches 256 bytes, two per table entry
+#define MAXDEFERRED 64  // JACC tables without a bound waiting for the rest of the code
+#define DF_TARGET (M8B_DF_ENTRY | M8B_DF_JUMP | M8B_DF_CASE | M8B_DF_CALL)
+#define NODEPTH   (-0x8000)
+
+// JACC whose table is probed after everything else was followed
+typedef struct deferred_jacc_t
+{
+    uint16 ea;
+    uint16 eaTable;
+    uint16 nCases;
+    uint8 max;
+    uint8 fProbed;
+}
+deferred_jacc;
+
+static size_t add_target(uint8* rgbFlags, uint16* rgeaWork, size_t nWork, size_t cbROM, uint16 ea, uint8 flag);
+static size_t probe_cases(const m8b_decoder* pDecoder, const uint8* rgbFlags, uint16 eaTable, size_t nMax);
+static size_t summarize(const m8b_decoder* pDecoder, const uint8* rgbFlags, m8b_call_effect* rgEffects, uint16 eaFunc, uint16* rgeaWork, int16* rgnDepth);
+static size_t follow(uint16* rgeaWork, size_t nWork, int16* rgnDepth, size_t cbROM, size_t ea, int nDepth, bool* pfFull);
+
+// Recursive descent from the given roots (the reset and interrupt vectors),
+// the same way emu() follows the code: jumps and calls are queued, a JACC with
+// A known goes to its one case, otherwise to the JMP/RET entries of its table
+// (bounded by an AND mask in the same run). Tables without a bound are probed
+// once nothing else is left to follow, highest first, and their cases are
+// reported at the end, cut where the table of another JACC starts. Every
+// reference found is passed to pfnRef. rgbFlags gets M8B_DF_xxx for each of
+// the cbROM bytes; rgeaWork needs cbROM entries. Nothing else is shared, so
+// any number of ROMs can be disassembled in parallel. Returns the number of
+// instructions.
+size_t m8b_descend(const m8b_decoder* pDecoder, const uint16* rgeaRoots, size_t nRoots, uint8* rgbFlags, uint16* rgeaWork, m8b_ref_cb pfnRef, void* pvContext)
+{
+    const opcode_desc* pOpcode;
+    deferred_jacc rgDeferred[MAXDEFERRED];
+    deferred_jacc* pJacc;
+    m8b_ref rgRefs[M8B_MAXREFS];
+    m8b_regstate state;
+    m8b_insn insn;
+    m8b_ref ref;
+    size_t cbROM = pDecoder->cbROM;
+    size_t i, n, nRefs, nCases, nWork = 0, nInsns = 0, nDeferred = 0, nPending = 0;
+    uint16 max;
+    size_t ea;
+
+    memset(rgbFlags, 0, cbROM);
+    for (i = 0; i < nRoots; ++i)
+        nWork = add_target(rgbFlags, rgeaWork, nWork, cbROM, rgeaRoots[i], M8B_DF_ENTRY);
+
+    ref.type = rt_jump;
+    ref.fWrite = 0;
+    while (nWork || nPending)
+    {
+        if (!nWork)
+        {
+            for (i = 0, pJacc = NULL; i < nDeferred; ++i)
+                if (!rgDeferred[i].fProbed && (!pJacc || rgDeferred[i].eaTable > pJacc->eaTable))
+                    pJacc = rgDeferred + i;
+
+            pJacc->nCases = (uint16)probe_cases(pDecoder, rgbFlags, pJacc->eaTable, pJacc->max / 2 + 1);
+            pJacc->fProbed = 1;
+            --nPending;
+            for (i = 0; i < pJacc->nCases; ++i)
+                nWork = add_target(rgbFlags, rgeaWork, nWork, cbROM, (uint16)(pJacc->eaTable + 2 * i), M8B_DF_JUMP | M8B_DF_CASE);
+            continue;
+        }
+
+        ea = rgeaWork[--nWork];
+        state.flags = 0;
+        max = 0xFF;
+
+        while (ea < cbROM && !(rgbFlags[ea] & (M8B_DF_CODE | M8B_DF_TAIL)))
+        {
+            if (!m8b_decode(pDecoder, ea, &insn)) break;
+            if (insn.size > 1 && (rgbFlags[ea + 1] & M8B_DF_CODE)) break;
+
+            pOpcode = rgOpcodes + insn.code;
+            rgbFlags[ea] |= M8B_DF_CODE;
+            if (insn.size > 1) rgbFlags[ea + 1] |= M8B_DF_TAIL;
+            ++nInsns;
+
+            nRefs = m8b_xrefs(&insn, rgRefs);
+            for (n = 0; n < nRefs; ++n)
+            {
+                if (insn.itype == M8B_JACC && rgRefs[n].type == rt_jump) continue;
+                if (pfnRef) pfnRef(pvContext, &insn, rgRefs + n);
+
+                if (rgRefs[n].type == rt_jump)
+                    nWork = add_target(rgbFlags, rgeaWork, nWork, cbROM, rgRefs[n].to, M8B_DF_JUMP);
+                else if (rgRefs[n].type == rt_call)
+                    nWork = add_target(rgbFlags, rgeaWork, nWork, cbROM, rgRefs[n].to, M8B_DF_CALL);
+                else if (rgRefs[n].type == rt_table && rgRefs[n].to < cbROM)
+                    rgbFlags[rgRefs[n].to] |= M8B_DF_TABLE;
+            }
+
+            if (insn.itype == M8B_JACC)
+            {
+                if (insn.addr < cbROM) rgbFlags[insn.addr] |= M8B_DF_JACC;
+
+                if (state.flags & M8B_RS_A)
+                {
+                    ref.to = m8b_table_addr(insn.addr, state.a);
+                    if (pfnRef) pfnRef(pvContext, &insn, &ref);
+                    nWork = add_target(rgbFlags, rgeaWork, nWork, cbROM, ref.to, M8B_DF_JUMP);
+                }
+                else if (max != 0xFF || nDeferred == MAXDEFERRED)
+                {
+                    nCases = probe_cases(pDecoder, rgbFlags, insn.addr, max / 2 + 1);
+                    for (i = 0; i < nCases; ++i)
+                    {
+                        ref.to = (uint16)(insn.addr + 2 * i);
+                        if (pfnRef) pfnRef(pvContext, &insn, &ref);
+                        nWork = add_target(rgbFlags, rgeaWork, nWork, cbROM, ref.to, M8B_DF_JUMP | M8B_DF_CASE);
+                    }
+                }
+                else
+                {
+                    pJacc = rgDeferred + nDeferred++;
+                    pJacc->ea = insn.ea;
+                    pJacc->eaTable = insn.addr;
+                    pJacc->nCases = 0;
+                    pJacc->max = (uint8)max;
+                    pJacc->fProbed = 0;
+                    ++nPending;
+                }
+            }
+
+            // Largest A can be, from an AND mask and shifts since the run began
+            if (insn.itype == M8B_AND && pOpcode->op1 == opk_A)
+            {
+                if (pOpcode->op2 == opk_imm && insn.value < max) max = insn.value;
+            }
+            else if (insn.itype == M8B_ASL && max < 0x80)
+                max <<= 1;
+            else if (insn.itype == M8B_ASR && max < 0x80)
+                max >>= 1;
+            else if (m8b_writes(&insn) & M8B_RS_A)
+                max = 0xFF;
+            m8b_track(&state, &insn);
+            if ((state.flags & M8B_RS_A) && insn.itype == M8B_MOV)
+                max = state.a;
+
+            if (rgInstructions[insn.itype].feature & CF_STOP) break;
+            ea += insn.size;
+        }
+    }
+
+    for (n = 0; n < nDeferred; ++n)
+    {
+        pJacc = rgDeferred + n;
+        m8b_decode(pDecoder, pJacc->ea, &insn);
+        for (i = 0; i < pJacc->nCases; ++i)
+        {
+            ref.to = (uint16)(pJacc->eaTable + 2 * i);
+            if (i && (rgbFlags[ref.to] & M8B_DF_JACC)) break;
+            if (pfnRef) pfnRef(pvContext, &insn, &ref);
+        }
+    }
+
+    return nInsns;
+}
+
+// Summarize every CALL target of a descent (rgbFlags from m8b_descend)
+// bottom-up: a subroutine is walked once its callees are done, so whether they
+// return, what they write and how deep they go is known at each CALL. A callee
+// still being walked is recursion. rgEffects gets an entry for each of the
+// cbROM bytes, M8B_CE_DONE at the subroutines; rgeaWork needs 3 * cbROM
+// entries. Returns the number of subroutines.
+size_t m8b_summarize(const m8b_decoder* pDecoder, const uint8* rgbFlags, m8b_call_effect* rgEffects, uint16* rgeaWork)
+{
+    size_t cbROM = pDecoder->cbROM;
+    uint16* rgeaStack = rgeaWork;
+    size_t ea, eaCallee, nStack, nFuncs = 0;
+
+    memset(rgEffects, 0, cbROM * sizeof(m8b_call_effect));
+    for (ea = 0; ea < cbROM; ++ea)
+    {
+        if ((rgbFlags[ea] & (M8B_DF_CODE | M8B_DF_CALL)) != (M8B_DF_CODE | M8B_DF_CALL) || (rgEffects[ea].flags & M8B_CE_DONE))
+            continue;
+
+        // Walked again from the start after each callee it had to wait for
+        rgeaStack[0] = (uint16)ea;
+        rgEffects[ea].flags = M8B_CE_ACTIVE;
+        for (nStack = 1; nStack; )
+        {
+            eaCallee = summarize(pDecoder, rgbFlags, rgEffects, rgeaStack[nStack - 1], rgeaWork + cbROM, (int16*)(rgeaWork + 2 * cbROM));
+            if (eaCallee < cbROM)
+            {
+                rgEffects[eaCallee].flags = M8B_CE_ACTIVE;
+                rgeaStack[nStack++] = (uint16)eaCallee;
+                continue;
+            }
+
+            --nStack;
+            ++nFuncs;
+        }
+    }
+
+    return nFuncs;
+}
+
+// Data stack depth at every instruction reachable from eaFunc, keeping the
+// deepest one where paths meet. Stores the effect and returns cbROM, or
+// returns a callee that has to be summarized first.
+static size_t summarize(const m8b_decoder* pDecoder, const uint8* rgbFlags, m8b_call_effect* rgEffects, uint16 eaFunc, uint16* rgeaWork, int16* rgnDepth)
+{
+    const m8b_call_effect* pCallee;
+    m8b_call_effect effect;
+    m8b_ref rgRefs[M8B_MAXREFS];
+    m8b_insn insn;
+    size_t cbROM = pDecoder->cbROM;
+    size_t ea, i, n, nRefs, nWork = 0;
+    int nDepth;
+    bool fFlow, fFull = false;
+
+    m8b_effect_init(&effect);
+    for (ea = 0; ea < cbROM; ++ea)
+        rgnDepth[ea] = NODEPTH;
+    nWork = follow(rgeaWork, nWork, rgnDepth, cbROM, eaFunc, 0, &fFull);
+
+    while (nWork)
+    {
+        ea = rgeaWork[--nWork];
+        if (!m8b_decode(pDecoder, ea, &insn))
+        {
+            effect.flags |= M8B_CE_PARTIAL;
+            continue;
+        }
+
+        pCallee = NULL;
+        if (insn.itype == M8B_CALL && insn.addr < cbROM)
+        {
+            pCallee = rgEffects + insn.addr;
+            if (!(pCallee->flags & (M8B_CE_DONE | M8B_CE_ACTIVE)))
+                return insn.addr;
+        }
+
+        nDepth = rgnDepth[ea];
+        fFlow = m8b_effect_step(&effect, &insn, pCallee, &nDepth);
+        if (fFull) effect.flags |= M8B_CE_UNBOUNDED;
+        if (effect.flags & M8B_CE_UNBOUNDED) break;
+
+        if (fFlow)
+            nWork = follow(rgeaWork, nWork, rgnDepth, cbROM, ea + insn.size, nDepth, &fFull);
+        if (insn.itype == M8B_CALL)
+            continue;
+
+        nRefs = m8b_xrefs(&insn, rgRefs);
+        for (n = 0; n < nRefs; ++n)
+        {
+            if (rgRefs[n].type == rt_jump && insn.itype != M8B_JACC)
+                nWork = follow(rgeaWork, nWork, rgnDepth, cbROM, rgRefs[n].to, nDepth, &fFull);
+        }
+
+        // The cases the descent found, a table without any is not followed
+        if (insn.itype == M8B_JACC)
+        {
+            for (i = 0, ea = insn.addr; ea < cbROM && (rgbFlags[ea] & M8B_DF_CASE); ++i, ea += 2)
+            {
+                if (i && (rgbFlags[ea] & M8B_DF_JACC)) break;
+                nWork = follow(rgeaWork, nWork, rgnDepth, cbROM, ea, nDepth, &fFull);
+            }
+            if (!i) effect.flags |= M8B_CE_PARTIAL;
+        }
+    }
+
+    m8b_effect_done(&effect);
+    rgEffects[eaFunc] = effect;
+    return cbROM;
+}
+
+void m8b_effect_init(m8b_call_effect* pEffect)
+{
+    memset(pEffect, 0, sizeof(*pEffect));
+    pEffect->nNet = M8B_NONET;
+}
+
+// One instruction of a walk through a subroutine: *pnDepth is the data stack
+// depth before it and comes back as the depth after. pCallee is the effect of
+// a CALL's target, NULL if it is not known. Deeper than M8B_MAXDEPTH the walk
+// is M8B_CE_UNBOUNDED and should stop. Returns whether the next instruction
+// is reached; HALT waits for a reset.
+bool m8b_effect_step(m8b_call_effect* pEffect, const m8b_insn* pInsn, const m8b_call_effect* pCallee, int* pnDepth)
+{
+    int nDepth = *pnDepth, nAfter = *pnDepth;
+    bool fFlow = !(rgInstructions[pInsn->itype].feature & CF_STOP) && pInsn->itype != M8B_HALT;
+
+    switch (pInsn->itype)
+    {
+    case M8B_PUSH:
+        ++nAfter;
+        break;
+    case M8B_POP:
+    case M8B_IPRET:
+        --nAfter;
+        break;
+    case M8B_EI:
+        pEffect->flags |= M8B_CE_EI;
+        break;
+    case M8B_SWAP:
+        if (rgOpcodes[pInsn->code].op2 != opk_DSP) break;
+        pEffect->flags |= M8B_CE_RESET;
+        nAfter = 0;
+        break;
+    case M8B_MOV:
+        if (rgOpcodes[pInsn->code].op1 == opk_PSP) pEffect->flags |= M8B_CE_RESET;
+        break;
+    case M8B_CALL:
+        if (!pCallee)
+        {
+            pEffect->flags |= M8B_CE_PARTIAL;
+            pEffect->fWrites = M8B_RS_ALL;
+            break;
+        }
+        if (pCallee->flags & M8B_CE_ACTIVE)
+        {
+            pEffect->flags |= M8B_CE_UNBOUNDED;
+            pEffect->fWrites = M8B_RS_ALL;
+            break;
+        }
+
+        pEffect->flags |= pCallee->flags & (M8B_CE_UNBOUNDED | M8B_CE_PARTIAL | M8B_CE_EI | M8B_CE_RESET);
+        pEffect->fWrites |= pCallee->fWrites;
+        if (2 + pCallee->nPSP > pEffect->nPSP) pEffect->nPSP = (uint8)(2 + pCallee->nPSP);
+        if (nDepth + pCallee->nDSP > pEffect->nDSP) pEffect->nDSP = (uint8)(nDepth + pCallee->nDSP);
+        nAfter = nDepth + pCallee->nNet;
+        if (pCallee->flags & M8B_CE_NORETURN) fFlow = false;
+        break;
+    }
+
+    if (pInsn->itype != M8B_CALL)
+        pEffect->fWrites |= m8b_writes(pInsn);
+    if (nAfter >= M8B_MAXDEPTH || nAfter <= -M8B_MAXDEPTH || pEffect->nPSP >= M8B_MAXDEPTH)
+    {
+        pEffect->flags |= M8B_CE_UNBOUNDED;
+        return false;
+    }
+    if (nAfter > pEffect->nDSP) pEffect->nDSP = (uint8)nAfter;
+
+    if (pInsn->itype == M8B_RET || pInsn->itype == M8B_RETI || pInsn->itype == M8B_IPRET)
+    {
+        if (pEffect->nNet != M8B_NONET && nAfter != pEffect->nNet) pEffect->flags |= M8B_CE_UNEVEN;
+        if (pEffect->nNet == M8B_NONET || nAfter > pEffect->nNet) pEffect->nNet = (int8)nAfter;
+    }
+
+    *pnDepth = nAfter;
+    return fFlow;
+}
+
+// Only a walk that saw everything can tell the subroutine never returns
+void m8b_effect_done(m8b_call_effect* pEffect)
+{
+    if (pEffect->flags & (M8B_CE_UNBOUNDED | M8B_CE_PARTIAL))
+        pEffect->fWrites = M8B_RS_ALL;
+    else if (pEffect->nNet == M8B_NONET)
+        pEffect->flags |= M8B_CE_NORETURN;
+
+    if (pEffect->nNet == M8B_NONET) pEffect->nNet = 0;
+    pEffect->flags |= M8B_CE_DONE;
+}
+
+// Queue ea for the walk if it is reached deeper than before
+static size_t follow(uint16* rgeaWork, size_t nWork, int16* rgnDepth, size_t cbROM, size_t ea, int nDepth, bool* pfFull)
+{
+    if (ea >= cbROM || nDepth <= rgnDepth[ea])
+        return nWork;
+
+    if (nWork == cbROM)
+    {
+        *pfFull = true;
+        return nWork;
+    }
+
+    rgnDepth[ea] = (int16)nDepth;
+    rgeaWork[nWork++] = (uint16)ea;
+    return nWork;
+}
+
+// Queue ea unless it was queued before
+static size_t add_target(uint8* rgbFlags, uint16* rgeaWork, size_t nWork, size_t cbROM, uint16 ea, uint8 flag)
+{
+    if (ea >= cbROM) return nWork;
+
+    if (!(rgbFlags[ea] & DF_TARGET))
+        rgeaWork[nWork++] = ea;
+    rgbFlags[ea] |= flag;
+    return nWork;
+}
+
+// JACC table entries: JMPs or returns, up to the start of another table or an
+// entry something other than a table jumps to (a routine after the table)
+static size_t probe_cases(const m8b_decoder* pDecoder, const uint8* rgbFlags, uint16 eaTable, size_t nMax)
+{
+    size_t i, ea;
+    uint8 flags;
+
+    if (nMax > MAXCASES) nMax = MAXCASES;
+    for (i = 0; i < nMax; ++i)
+    {
+        ea = eaTable + 2 * i;
+        if (ea + 1 >= pDecoder->cbROM) break;
+
+        flags = rgbFlags[ea];
+        if (flags & M8B_DF_TAIL) break;
+        if (i && (flags & (M8B_DF_ENTRY | M8B_DF_CALL | M8B_DF_TABLE | M8B_DF_JACC))) break;
+        if (i && (flags & M8B_DF_JUMP) && !(flags & M8B_DF_CASE)) break;
+
+        switch (rgOpcodes[pDecoder->pbROM[ea]].itype)
+        {
+        case M8B_JMP:
+        case M8B_RET:
+        case M8B_RETI:
+        case M8B_IPRET:
+            continue;
+        }
+        break;
+    }
+
+    return i;
+}
@@ -1,11 +1,18 @@
-#include "m8b.hpp"
+#include "dec.hpp"
 #include "queue.hpp"
 #include <frame.hpp>
 
+#define RAM_CELLS 0x100
+
 static bool fFlow;
+static uint32 rgdwRamNamed[RAM_CELLS / 32];     // RAM bytes name_ram_refs() has seen
+static uint32 rgdwRamPending[RAM_CELLS / 32];   // RAM bytes referenced since, waiting for a name
 
 static void op_imm(int n);
 static void op_emu(op_t& x, int fIsLoad);
+static void set_port_cmt(ea_t ea, ea_t eaPort, uint8 value);
+static void make_index_table(ea_t eaTable);
+static bool is_table_boundary(ea_t ea, ea_t eaTable);
 
 static void op_imm(int n)
 {
@@ -66,11 +73,8 @@ static void op_emu(op_t& x, int fIsLoad)
             ea = toRAM(x.addr);
             if (ea != BADADDR)
             {
-                if (!has_any_name(get_flags_novalue(ea)))
-                {
-                    qsnprintf(szLabel, sizeof(szLabel), "ram_%0.2X", x.addr);
-                    set_name(ea, szLabel, SN_NOWARN);
-                }
+                if (x.addr < RAM_CELLS && !(rgdwRamNamed[x.addr / 32] & (1u << (x.addr % 32))))
+                    rgdwRamPending[x.addr / 32] |= 1u << (x.addr % 32);
                 ua_dodata2(x.offb, ea, x.dtyp);
                 if (!fIsLoad) doVar(ea);
                 ua_add_dref(x.offb, ea, cmd.itype == M8B_IORD ? dr_R : dr_W);
@@ -95,7 +99,7 @@ static void op_emu(op_t& x, int fIsLoad)
                 ftype = fl_JN;
                 if (InstrIsSet(cmd.itype, CF_CALL))
                 {
-                    if (!func_does_return(ea))
+                    if (!call_returns(ea))
                         fFlow = false;
                     ftype = fl_CN;
                 }
@@ -108,17 +112,54 @@ static void op_emu(op_t& x, int fIsLoad)
     warning("%a: %s,%d: bad optype %d", cmd.ea, cmd.get_canon_mnem(), x.n, x.type);
 }
 
+// Name the RAM bytes operands referred to since the last call ram_xx, unless
+// they have a name (cfg aliases, stack pointers, user names). Runs when the
+// analysis queue is empty instead of once for every operand.
+void name_ram_refs()
+{
+    char szLabel[MAXSTR];
+    size_t i, nBit;
+    ea_t ea;
+
+    for (i = 0; i < qnumber(rgdwRamPending); ++i)
+    {
+        if (!rgdwRamPending[i]) continue;
+
+        for (nBit = 0; nBit < 32; ++nBit)
+        {
+            if (!(rgdwRamPending[i] & (1u << nBit))) continue;
+
+            ea = toRAM(i * 32 + nBit);
+            if (ea != BADADDR && !has_any_name(get_flags_novalue(ea)))
+            {
+                qsnprintf(szLabel, sizeof(szLabel), "ram_%0.2X", (uint32)(i * 32 + nBit));
+                set_name(ea, szLabel, SN_NOWARN);
+            }
+        }
+
+        rgdwRamNamed[i] |= rgdwRamPending[i];
+        rgdwRamPending[i] = 0;
+    }
+}
+
+void reset_ram_names()
+{
+    memset(rgdwRamNamed, 0, sizeof(rgdwRamNamed));
+    memset(rgdwRamPending, 0, sizeof(rgdwRamPending));
+}
+
 int idaapi emu()
 {
     char szLabel[MAXSTR];
     insn_t saved;
-    segment_t* pSegment;
-    ea_t ea, length, offset;
-    flags_t flags;
-    uint32 dwFeature, i;
+    switch_info_ex_t si;
+    m8b_regstate state;
+    ea_t ea, eaPort;
+    uint32 dwFeature;
 
     dwFeature = cmd.get_canon_feature();
     fFlow = !(dwFeature & CF_STOP);
+    mark_dirty(cmd.ea);
 
     if (dwFeature & CF_USE1) op_emu(cmd.Op1, 1);
     if (dwFeature & CF_USE2) op_emu(cmd.Op2, 1);
@@ -136,62 +177,67 @@ int idaapi emu()
         if (cmd.itype == M8B_SWAP && !cmd.Op2.is_reg(rDSP))
             break;
 
-        for (i = 0; i < 5; ++i)
+        if (get_regstate(cmd.ea, &state) && (state.flags & M8B_RS_A))
         {
-            ea = decode_prev_insn(cmd.ea);
-            if (ea == BADADDR) break;
-            if (cmd.itype == M8B_MOV && cmd.Op1.is_reg(rA) && cmd.Op2.type == o_imm)
+            ea = toRAM(state.a);
+            if (ea != BADADDR)
             {
-                ea = toRAM(cmd.Op2.value);
-                if (ea != BADADDR)
-                {
-                    qsnprintf(szLabel, sizeof(szLabel), "%s_%0.2X", cmd.itype == M8B_MOV ? "psp" : "dsp", cmd.Op2.value);
-                    ua_add_dref(cmd.Op2.offb, ea, dr_O);
-                    set_name(ea, szLabel, SN_NOWARN);
-                }
-                break;
+                qsnprintf(szLabel, sizeof(szLabel), "%s_%0.2X", cmd.itype == M8B_MOV ? "psp" : "dsp", state.a);
+                ua_add_dref(0, ea, dr_O);
+                set_name(ea, szLabel, SN_NOWARN);
             }
         }
         break;
+    case M8B_AND:
+    case M8B_OR:
+    case M8B_XOR:
+    case M8B_CMP:
+        // Mask applied to a port value read by an IORD of the same block
+        if (cmd.Op1.is_reg(rA) && cmd.Op2.type == o_imm && get_regstate(cmd.ea, &state) && (state.flags & M8B_RS_APORT))
+        {
+            ea = toROM(state.eaRead);
+            if (ea != BADADDR) set_port_cmt(ea, state.a, (uint8)cmd.Op2.value);
+        }
+        break;
+    case M8B_INDEX:
+        if (get_regstate(cmd.ea, &state) && (state.flags & M8B_RS_A))
+        {
+            ea = toROM(m8b_table_addr((uint16)cmd.Op1.addr, state.a));
+            if (ea != BADADDR) ua_add_dref(cmd.Op1.offb, ea, dr_R);
+        }
+
+        ea = toROM(cmd.Op1.addr);
+        if (ea != BADADDR) make_index_table(ea);
+        break;
     case M8B_JACC:
-        pSegment = getseg(cmd.ea);
-        if (!pSegment) break;
-        length = pSegment->endEA - cmd.ea;
-        if (length > 256) length = 256;
-        for (offset = 2; offset < length; offset += 2)
+        // A known on every path into the dispatch selects the entry
+        if (get_regstate(cmd.ea, &state) && (state.flags & M8B_RS_A))
         {
-            ea = toROM(saved.Op1.addr + offset);
-            if (ea == BADADDR) break;
-            flags = getFlags(ea);
-            if (!hasValue(flags) || (has_any_name(flags) || hasRef(flags)) || !create_insn(ea)) break;
-            switch (cmd.itype)
-            {
-            case M8B_JMP:
-            case M8B_RET:
-            case M8B_RETI:
-            case M8B_IPRET:
-                add_cref(saved.ea, ea, fl_JN);
-                break;
-            default:
-                offset = length;
-            }
+            ea = toROM(m8b_table_addr((uint16)cmd.Op1.addr, state.a));
+            if (ea != BADADDR) ua_add_cref(cmd.Op1.offb, ea, fl_JN);
+        }
+        else if (is_switch(&si))
+        {
+            set_switch_info_ex(cmd.ea, &si);
+            add_switch_xrefs(cmd.ea, &si);
         }
         break;
-    case M8B_IORD:
     case M8B_IOWR:
     case M8B_IOWX:
-        for (i = 0; i < 5; ++i)
+        if (!get_regstate(cmd.ea, &state))
+            break;
+
+        // IOWX writes port X+expr; without X the comment names expr as before
+        eaPort = cmd.Op1.addr;
+        if (cmd.itype == M8B_IOWX && (state.flags & M8B_RS_X))
         {
-            ea = (saved.itype == M8B_IORD) ? decode_insn(cmd.ea + cmd.size) : decode_prev_insn(cmd.ea);
-            if (ea == BADADDR) break;
-            if (cmd.Op1.is_reg(rA) && cmd.Op2.type == o_imm)
-            {
-                qsnprintf(szLabel, sizeof(szLabel), "[A=%0.2Xh] ", cmd.Op2.value);
-                if (get_portbits_sym(szLabel + qstrlen(szLabel), saved.Op1.addr, cmd.Op2.value))
-                    set_cmt(saved.ea, szLabel, false);
-                break;
-            }
+            eaPort = (eaPort + state.x) & 0xFF;
+            ea = toIOP(eaPort);
+            if (ea != BADADDR) ua_add_dref(cmd.Op1.offb, ea, dr_W);
         }
+
+        if (state.flags & M8B_RS_A)
+            set_port_cmt(cmd.ea, eaPort, state.a);
     }
     cmd = saved;
 
@@ -212,3 +258,66 @@ int idaapi emu()
 
     return 1;
 }
+
+static void set_port_cmt(ea_t ea, ea_t eaPort, uint8 value)
+{
+    char szLabel[MAXSTR];
+
+    qsnprintf(szLabel, sizeof(szLabel), "[A=%0.2Xh] ", value);
+    if (get_portbits_sym(szLabel + qstrlen(szLabel), eaPort, value))
+        set_cmt(ea, szLabel, false);
+}
+
+// Turn an INDEX table into one byte array. It spans the A range reaching the
+// INDEX when an AND/CMP bounds it, and in any case ends at the next label,
+// code or reference that does not come from an INDEX of the same table.
+static void make_index_table(ea_t eaTable)
+{
+    segment_t* pSegment;
+    ea_t ea, eaEnd, eaDefault;
+    uint8 max;
+
+    pSegment = getseg(eaTable);
+    if (!pSegment || isCode(getFlags(eaTable))) return;
+
+    eaEnd = eaTable + 0x100;
+    if (get_a_bound(cmd.ea, &max, &eaDefault))
+        eaEnd = eaTable + max + 1;
+    if (eaEnd > pSegment->endEA)
+        eaEnd = pSegment->endEA;
+
+    for (ea = eaTable + 1; ea < eaEnd; ea++)
+    {
+        if (is_table_boundary(ea, eaTable))
+            break;
+    }
+    eaEnd = ea;
+
+    // Already an array at least this long, leave it alone
+    if (isByte(getFlags(eaTable)) && get_item_end(eaTable) >= eaEnd)
+        return;
+
+    do_unknown_range(eaTable, eaEnd - eaTable, DOUNK_SIMPLE);
+    doByte(eaTable, eaEnd - eaTable);
+}
+
+static bool is_table_boundary(ea_t ea, ea_t eaTable)
+{
+    m8b_insn insn;
+    flags_t flags;
+    ea_t eaRef;
+
+    flags = getFlags(ea);
+    if (!hasValue(flags) || isCode(flags) || has_user_name(flags))
+        return true;
+    if (get_first_cref_to(ea) != BADADDR)
+        return true;
+
+    for (eaRef = get_first_dref_to(ea); eaRef != BADADDR; eaRef = get_next_dref_to(ea, eaRef))
+    {
+        if (!decode_rom(eaRef, &insn) || insn.itype != M8B_INDEX || toROM(insn.addr) != eaTable)
+            return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,93 @@
+#include "dec.hpp"
+#include <stdio.h>
+#include <string.h>
+
+static const char* rgszRegNames[] = { "A", "X", "DSP", "PSP" };
+
+// Number in CYASM syntax (ASH_HEXF0): hex with an 'h' suffix and a leading zero
+// if the first digit is a letter. Like IDA, single digits are printed as is.
+static size_t format_hex(char* szBuf, size_t cchBuf, uint32 value)
+{
+    char szDigits[16];
+
+    if (value < 10)
+        return snprintf(szBuf, cchBuf, "%u", value);
+
+    snprintf(szDigits, sizeof(szDigits), "%X", value);
+    return snprintf(szBuf, cchBuf, szDigits[0] > '9' ? "0%sh" : "%sh", szDigits);
+}
+
+// Operand n (0 or 1) as out()/outop() print it when no names are known.
+// Returns its length, 0 if the instruction has no such operand.
+size_t m8b_render_operand(const m8b_insn* pInsn, size_t n, char* szOperand, size_t cchOperand)
+{
+    const opcode_desc* pOpcode;
+    char szNumber[16];
+    uint8 kind;
+    int cch = 0;
+
+    *szOperand = '\0';
+    if (!pInsn->size || n > 1)
+        return 0;
+
+    pOpcode = rgOpcodes + pInsn->code;
+    kind = n ? pOpcode->op2 : pOpcode->op1;
+
+    switch (kind)
+    {
+    case opk_A:
+    case opk_X:
+    case opk_DSP:
+    case opk_PSP:
+        cch = snprintf(szOperand, cchOperand, "%s", rgszRegNames[kind - opk_A]);
+        break;
+    case opk_imm:
+        cch = (int)format_hex(szOperand, cchOperand, pInsn->value);
+        break;
+    case opk_mem:
+        format_hex(szNumber, sizeof(szNumber), pInsn->value);
+        switch (pInsn->itype)
+        {
+        case M8B_IORD:
+        case M8B_IOWR:
+        case M8B_IPRET:
+            cch = snprintf(szOperand, cchOperand, "%s", szNumber);
+            break;
+        default:
+            cch = snprintf(szOperand, cchOperand, "[%s]", szNumber);
+        }
+        break;
+    case opk_displ:
+        format_hex(szNumber, sizeof(szNumber), pInsn->value);
+        cch = snprintf(szOperand, cchOperand, "[X+%s]", szNumber);
+        break;
+    case opk_near:
+    case opk_near1:
+        cch = (int)format_hex(szOperand, cchOperand, pInsn->addr);
+        break;
+    }
+
+    return cch < 0 ? 0 : (size_t)cch;
+}
+
+// Whole instruction in the layout of out(): the mnemonic padded to 8 columns,
+// operands separated by ", ". Invalid bytes come out as DB.
+size_t m8b_render(const m8b_insn* pInsn, char* szLine, size_t cchLine)
+{
+    char szOp1[32], szOp2[32], szNumber[16];
+    int cch;
+
+    if (!pInsn->size)
+    {
+        format_hex(szNumber, sizeof(szNumber), pInsn->code);
+        cch = snprintf(szLine, cchLine, "%-8s%s", "DB", szNumber);
+    }
+    else if (!m8b_render_operand(pInsn, 0, szOp1, sizeof(szOp1)))
+        cch = snprintf(szLine, cchLine, "%s", rgInstructions[pInsn->itype].name);
+    else if (!m8b_render_operand(pInsn, 1, szOp2, sizeof(szOp2)))
+        cch = snprintf(szLine, cchLine, "%-8s%s", rgInstructions[pInsn->itype].name, szOp1);
+    else
+        cch = snprintf(szLine, cchLine, "%-8s%s, %s", rgInstructions[pInsn->itype].name, szOp1, szOp2);
+
+    return cch < 0 ? 0 : (size_t)cch;
+}
@@ -0,0 +1,165 @@
+#ifdef __IDP__
+#include <pro.h>
+#else
+#include "nosdk.hpp"
+#endif
+#include "ihex.hpp"
+
+enum
+{
+    stStart = 0,            // waiting for ':'
+    stHigh,                 // expecting the first digit of a byte
+    stLow,                  // expecting the second digit of a byte
+    stEnd                   // record complete, skipping to the end of line
+};
+
+static int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+void ihex_init(ihex_parser* pParser, ihex_data_cb pfnData, void* pvContext)
+{
+    pParser->pfnData = pfnData;
+    pParser->pvContext = pvContext;
+    pParser->eaBase = 0;
+    pParser->nLine = 1;
+    pParser->status = ihex_ok;
+    pParser->state = stStart;
+    pParser->byHigh = 0;
+    pParser->bySum = 0;
+    pParser->cbRecord = 0;
+}
+
+// Handle a record whose bytes (count, address, type, data, checksum) are all in
+// rgbyRecord and whose checksum has been verified.
+static int end_record(ihex_parser* pParser)
+{
+    const uint8* pb = pParser->rgbyRecord;
+    size_t cb = pb[0];
+    uint32 ea = (pb[1] << 8) | pb[2];
+
+    switch (pb[3])
+    {
+    case 0x00:              // data
+        if (cb && !pParser->pfnData(pParser->pvContext, pParser->eaBase + ea, pb + 4, cb))
+            return ihex_aborted;
+        return ihex_ok;
+    case 0x01:              // end of file
+        return ihex_eof;
+    case 0x02:              // extended segment address
+        if (cb != 2) return ihex_syntax;
+        pParser->eaBase = (((uint32)pb[4] << 8) | pb[5]) << 4;
+        return ihex_ok;
+    case 0x04:              // extended linear address
+        if (cb != 2) return ihex_syntax;
+        pParser->eaBase = (((uint32)pb[4] << 8) | pb[5]) << 16;
+        return ihex_ok;
+    case 0x03:              // start segment address
+    case 0x05:              // start linear address
+        return ihex_ok;
+    default:
+        return ihex_syntax;
+    }
+}
+
+// Parse the next chunk of input. Returns ihex_ok while more input is expected,
+// ihex_eof once the end of file record was seen, otherwise an error.
+int ihex_feed(ihex_parser* pParser, const char* pch, size_t cch)
+{
+    const char* pchEnd = pch + cch;
+    uint8 by;
+    int digit;
+
+    for (; pParser->status == ihex_ok && pch < pchEnd; ++pch)
+    {
+        if (*pch == '\n')
+        {
+            if (pParser->state == stHigh || pParser->state == stLow)
+                return pParser->status = ihex_syntax;
+            ++pParser->nLine;
+            pParser->state = stStart;
+            continue;
+        }
+
+        switch (pParser->state)
+        {
+        case stStart:
+            if (*pch == ':')
+            {
+                pParser->state = stHigh;
+                pParser->bySum = 0;
+                pParser->cbRecord = 0;
+            }
+            else if (*pch != '\r' && *pch != ' ' && *pch != '\t' && *pch != 0x1A)
+                pParser->status = ihex_syntax;
+            break;
+
+        case stHigh:
+        case stLow:
+            digit = hex_digit(*pch);
+            if (digit < 0)
+            {
+                pParser->status = ihex_syntax;
+                break;
+            }
+            if (pParser->state == stHigh)
+            {
+                pParser->byHigh = (uint8)digit;
+                pParser->state = stLow;
+                break;
+            }
+
+            by = (uint8)((pParser->byHigh << 4) | digit);
+            pParser->rgbyRecord[pParser->cbRecord++] = by;
+            pParser->bySum = (uint8)(pParser->bySum + by);
+            pParser->state = stHigh;
+
+            // count + address + type + data + checksum
+            if (pParser->cbRecord == 5 + (size_t)pParser->rgbyRecord[0])
+            {
+                pParser->state = stEnd;
+                pParser->status = pParser->bySum ? ihex_checksum : end_record(pParser);
+            }
+            break;
+
+        case stEnd:
+            if (*pch != '\r' && *pch != ' ' && *pch != '\t')
+                pParser->status = ihex_syntax;
+            break;
+        }
+    }
+
+    return pParser->status;
+}
+
+// Call after the last chunk. A file without an end of file record is accepted
+// as long as it doesn't stop in the middle of a record.
+int ihex_finish(ihex_parser* pParser)
+{
+    if (pParser->status == ihex_ok && (pParser->state == stHigh || pParser->state == stLow))
+        pParser->status = ihex_syntax;
+
+    return pParser->status == ihex_eof ? ihex_ok : pParser->status;
+}
+
+const char* ihex_strerror(int status)
+{
+    switch (status)
+    {
+    case ihex_ok:
+    case ihex_eof:
+        return "no error";
+    case ihex_syntax:
+        return "malformed record";
+    case ihex_checksum:
+        return "checksum mismatch";
+    case ihex_aborted:
+        return "data rejected";
+    default:
+        return "unknown error";
+    }
+}
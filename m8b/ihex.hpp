@@ -0,0 +1,40 @@
+#ifndef IHEX_HPP_INCLUDED
+#define IHEX_HPP_INCLUDED
+
+// Streaming Intel HEX parser. Input can be fed in chunks of any size; every data
+// record is verified against its checksum and handed to the callback as soon as
+// it is complete, so no copy of the whole file is ever kept.
+
+enum ihex_status_t
+{
+    ihex_ok = 0,        // more input expected
+    ihex_eof,           // end of file record seen
+    ihex_syntax,        // malformed record
+    ihex_checksum,      // record checksum mismatch
+    ihex_aborted        // the callback returned false
+};
+
+// Called for each data record with its absolute address
+typedef bool (*ihex_data_cb)(void* pvContext, uint32 ea, const uint8* pbData, size_t cbData);
+
+typedef struct ihex_parser_t
+{
+    ihex_data_cb pfnData;
+    void* pvContext;
+    uint32 eaBase;          // from extended segment/linear address records
+    size_t nLine;           // current line, for error messages
+    int status;
+    int state;              // see ihex.cpp
+    uint8 byHigh;           // first digit of a pair
+    uint8 bySum;
+    size_t cbRecord;        // bytes of the current record read so far
+    uint8 rgbyRecord[5 + 255];
+}
+ihex_parser;
+
+void ihex_init(ihex_parser* pParser, ihex_data_cb pfnData, void* pvContext);
+int ihex_feed(ihex_parser* pParser, const char* pch, size_t cch);
+int ihex_finish(ihex_parser* pParser);
+const char* ihex_strerror(int status);
+
+#endif
@@ -1,4 +1,4 @@
-#include "m8b.hpp"
+#include "dec.hpp"
 
 instruc_t rgInstructions[] =
 {
@@ -0,0 +1,115 @@
+#include "sig.hpp"
+
+#define SIG_FILE "m8b.sig"
+
+static qvector<uint32> qvIndexFile;     // the index file; words keep the records aligned
+static m8b_sig_index sigIndex;
+static bool fIndexTried;                // SIG_FILE from the cfg folder was looked for
+
+static bool load_sig_index(const char* szPath);
+static bool idaapi menu_signatures(void*);
+
+// Name the known library routines (sig.hpp) in one pass over the ROM. Only
+// code labels IDA named itself (loc_, sub_) are renamed; functions get the
+// library flag. The index is cfg/m8b.sig unless another one was loaded.
+void apply_signatures()
+{
+    char szPath[QMAXPATH];
+    const uint8* pbROM;
+    m8b_decoder decoder;
+    segment_t* pSegment;
+    const char* szName;
+    func_t* pFunc;
+    flags_t flags;
+    size_t cbROM, nNamed = 0;
+    ea_t ea;
+
+    if (!fIndexTried)
+    {
+        fIndexTried = true;
+        if (getsysfile(szPath, sizeof(szPath), SIG_FILE, CFG_SUBDIR))
+            load_sig_index(szPath);
+    }
+
+    pSegment = segROM();
+    if (!sigIndex.nSigs || !pSegment) return;
+
+    pbROM = get_rom_bytes(pSegment->startEA, &cbROM);
+    if (!pbROM) return;
+    m8b_init(&decoder, pbROM, cbROM);
+
+    for (ea = pSegment->startEA; ea != BADADDR && ea < pSegment->endEA; ea = next_head(ea, pSegment->endEA))
+    {
+        flags = getFlags(ea);
+        if (!isCode(flags) || !has_dummy_name(flags)) continue;
+
+        szName = m8b_sig_match(&sigIndex, &decoder, ea - pSegment->startEA);
+        if (!szName || !do_name_anyway(ea, szName)) continue;
+        ++nNamed;
+
+        pFunc = get_func(ea);
+        if (pFunc && pFunc->startEA == ea)
+        {
+            pFunc->flags |= FUNC_LIB;
+            update_func(pFunc);
+        }
+    }
+
+    if (nNamed)
+        msg("%u library routines named\n", (uint32)nNamed);
+}
+
+void add_sig_menu()
+{
+    add_menu_item("Edit/Other", "M8 load fingerprints...", NULL, SETMENU_APP, menu_signatures, NULL);
+}
+
+void del_sig_menu()
+{
+    del_menu_item("Edit/Other/M8 load fingerprints...");
+}
+
+void reset_signatures()
+{
+    qvIndexFile.clear();
+    memset(&sigIndex, 0, sizeof(sigIndex));
+    fIndexTried = false;
+}
+
+static bool idaapi menu_signatures(void*)
+{
+    const char* szPath = askfile_c(0, "*.sig", "M8 function fingerprint index");
+
+    if (!szPath || !load_sig_index(szPath))
+        return false;
+
+    fIndexTried = true;
+    apply_signatures();
+    return true;
+}
+
+static bool load_sig_index(const char* szPath)
+{
+    size_t cbFile;
+    bool fOk;
+    FILE* fp;
+
+    fp = qfopen(szPath, "rb");
+    if (!fp) return false;
+
+    qfseek(fp, 0, SEEK_END);
+    cbFile = qftell(fp);
+    qfseek(fp, 0, SEEK_SET);
+
+    qvIndexFile.resize(cbFile / sizeof(uint32) + 1);
+    fOk = qfread(fp, qvIndexFile.begin(), cbFile) == (ssize_t)cbFile && m8b_sig_open(&sigIndex, qvIndexFile.begin(), cbFile);
+    qfclose(fp);
+
+    if (!fOk)
+    {
+        qvIndexFile.clear();
+        memset(&sigIndex, 0, sizeof(sigIndex));
+        warning("%s is not an M8 fingerprint index", szPath);
+    }
+    return fOk;
+}
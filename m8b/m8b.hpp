@@ -6,6 +6,7 @@
 #pragma warning(disable: 4267)
 #include "idaidp.hpp"
 #include "ins.hpp"
+#include "opc.hpp"
 #include <diskio.hpp>
 #pragma warning(default: 4267)
 
@@ -21,12 +22,66 @@ segment_t* segIOP();
 ea_t toROM(ea_t ea);
 ea_t toRAM(ea_t ea);
 ea_t toIOP(ea_t ea);
+const uint8* get_rom_bytes(ea_t ea, size_t* pcbLeft);
+uint8 get_rom_byte(ea_t ea);
+void patch_rom_snapshot(ea_t ea);
+
+typedef struct rom_entry_t
+{
+    ea_t ea;
+    char szName[MAXNAMELEN];
+}
+rom_entry;
+
+void get_rom_entries(qvector<rom_entry>& qvEntries);
 
 const char* get_port_sym(ea_t eaPort);
 const char* get_portbit_sym(ea_t eaPort, size_t nBit);
 bool get_portbits_sym(char szSym[MAXSTR], ea_t eaPort, size_t nMask);
 bool is_port_sym(const char* szName);
 
+struct m8b_insn_t;
+struct m8b_regstate_t;
+bool get_regstate(ea_t ea, struct m8b_regstate_t* pState);
+void track_insn(struct m8b_regstate_t* pState, const struct m8b_insn_t* pInsn);
+void invalidate_regstates();
+ea_t find_block_start(ea_t ea);
+bool decode_rom(ea_t ea, struct m8b_insn_t* pInsn);
+
+void mark_dirty(ea_t ea);
+void propagate();
+void reset_propagation();
+bool get_block_entry(ea_t ea, struct m8b_regstate_t* pState);
+void apply_call_summary(struct m8b_regstate_t* pState, ea_t eaCallee);
+
+struct m8b_decoder_t;
+struct m8b_call_effect_t;
+size_t store_call_effects(const struct m8b_decoder_t* pDecoder, const uint8* rgbFlags);
+bool get_call_effect(ea_t ea, struct m8b_call_effect_t* pEffect);
+void walk_call_effect(ea_t ea, struct m8b_call_effect_t* pEffect);
+bool call_returns(ea_t ea);
+void update_call_effects(const qvector<ea_t>& qvFuncs);
+
+int idaapi is_switch(switch_info_ex_t* si);
+void add_switch_xrefs(ea_t ea, const switch_info_ex_t* si);
+bool get_a_bound(ea_t ea, uint8* pMax, ea_t* peaDefault);
+
+void analyze_wcet();
+void add_wcet_menu();
+void del_wcet_menu();
+
+void analyze_stack();
+void add_stack_menu();
+void del_stack_menu();
+
+void name_ram_refs();
+void reset_ram_names();
+
+void apply_signatures();
+void reset_signatures();
+void add_sig_menu();
+void del_sig_menu();
+
 void idaapi header();
 void idaapi footer();
 
@@ -35,10 +90,12 @@ void idaapi segstart(ea_t ea);
 int idaapi ana();
 int idaapi emu();
 void idaapi out();
+void invalidate_out_cache();
 bool idaapi outop(op_t& op);
 
 bool idaapi can_have_type(op_t& x);
 int idaapi is_align_insn(ea_t ea);
 int idaapi is_sane_insn(int nocrefs);
+void invalidate_rom_class();
 
 #endif
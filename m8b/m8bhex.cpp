@@ -0,0 +1,130 @@
+// Intel HEX loader for Cypress enCoRe/M8 firmware dumps. The file is parsed in
+// one streaming pass straight into the ROM segment; the ROM is sized like the
+// default device in m8b.cfg so the processor module doesn't have to resize it.
+
+#include <idaldr.h>
+#include "ihex.hpp"
+
+#define SEGNAME_ROM     "ROM"
+#define ROMSIZE_DEFAULT 0x2000
+
+static char szCfgFile[] = "m8b.cfg";
+static size_t cbCfgROM;
+
+typedef struct load_ctx_t
+{
+    ea_t eaEnd;             // end of the ROM segment
+}
+load_ctx;
+
+static const char* idaapi parse_area_line(const ioport_t*, size_t, const char* szLine)
+{
+    char szSegmentName[MAXSTR], szSegmentClass[MAXSTR];
+    ea_t eaFrom, eaTo;
+
+    if (sscanf(szLine, "area %s %s %" FMT_EA "i:%" FMT_EA "i", szSegmentClass, szSegmentName, &eaFrom, &eaTo) == 4 &&
+        stristr(szSegmentName, SEGNAME_ROM))
+    {
+        cbCfgROM += (size_t)(eaTo - eaFrom);
+    }
+
+    return NULL;
+}
+
+// ROM size of the default device in m8b.cfg
+static size_t get_rom_size()
+{
+    char szPath[QMAXPATH], szDevice[MAXSTR] = "";
+    ioport_t* pPorts;
+    size_t nPorts = 0;
+
+    cbCfgROM = 0;
+    if (getsysfile(szPath, sizeof(szPath), szCfgFile, CFG_SUBDIR))
+    {
+        pPorts = read_ioports(&nPorts, szPath, szDevice, sizeof(szDevice), parse_area_line);
+        free_ioports(pPorts, nPorts);
+    }
+
+    return cbCfgROM ? cbCfgROM : ROMSIZE_DEFAULT;
+}
+
+static bool check_data(void*, uint32, const uint8*, size_t)
+{
+    return true;
+}
+
+static bool load_data(void* pvContext, uint32 ea, const uint8* pbData, size_t cbData)
+{
+    load_ctx* pCtx = (load_ctx*)pvContext;
+
+    if (ea + cbData > 0x10000)
+        return false;
+
+    if (ea + cbData > pCtx->eaEnd)
+    {
+        pCtx->eaEnd = ea + cbData;
+        set_segm_end(0, pCtx->eaEnd, SEGMOD_KILL);
+    }
+
+    mem2base(pbData, ea, ea + cbData, -1);
+    return true;
+}
+
+static int idaapi accept_file(linput_t* li, char szFormatName[MAX_FILE_FORMAT_NAME], int n)
+{
+    ihex_parser parser;
+    char szLine[600];
+    int status;
+
+    if (n) return 0;
+
+    qlseek(li, 0);
+    if (!qlgets(szLine, sizeof(szLine), li) || szLine[0] != ':')
+        return 0;
+
+    ihex_init(&parser, check_data, NULL);
+    status = ihex_feed(&parser, szLine, qstrlen(szLine));
+    if (status != ihex_ok && status != ihex_eof)
+        return 0;
+
+    // Any HEX file looks like this, so IDA's own loader stays the default
+    qstrncpy(szFormatName, "Intel HEX file (Cypress enCoRe/M8)", MAX_FILE_FORMAT_NAME);
+    return 1;
+}
+
+static void idaapi load_file(linput_t* li, ushort, const char*)
+{
+    ihex_parser parser;
+    load_ctx ctx;
+    char rgch[4096];
+    int32 cch;
+    int status = ihex_ok;
+
+    set_processor_type("M8B", SETPROC_ALL|SETPROC_FATAL);
+
+    ctx.eaEnd = get_rom_size();
+    if (!add_segm(0, 0, ctx.eaEnd, SEGNAME_ROM, CLASS_CODE))
+        loader_failure();
+
+    qlseek(li, 0);
+    ihex_init(&parser, load_data, &ctx);
+    while (status == ihex_ok && (cch = qlread(li, rgch, sizeof(rgch))) > 0)
+        status = ihex_feed(&parser, rgch, cch);
+    status = ihex_finish(&parser);
+
+    if (status != ihex_ok)
+        loader_failure("Line %u: %s", (uint32)parser.nLine, status == ihex_aborted ? "address out of range" : ihex_strerror(status));
+
+    create_filename_cmt();
+}
+
+loader_t LDSC =
+{
+    IDP_INTERFACE_VERSION,
+    0,                          // loader flags
+    accept_file,
+    load_file,
+    NULL,                       // save_file
+    NULL,                       // move_segm
+    NULL,                       // init_loader_options
+};
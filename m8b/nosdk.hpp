@@ -0,0 +1,37 @@
+#ifndef NOSDK_HPP_INCLUDED
+#define NOSDK_HPP_INCLUDED
+
+// The few IDA SDK definitions used by the decoder sources (ins.cpp, opc.cpp,
+// dec.cpp), so that they can be built without the SDK. See Makefile.
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint8_t  uchar;
+typedef uint8_t  uint8;
+typedef int8_t   int8;
+typedef int16_t  int16;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+typedef uint64_t uint64;
+typedef int32_t  int32;
+
+#define ENUM_SIZE(t) : t
+#define qnumber(array) (sizeof(array) / sizeof(array[0]))
+#define CASSERT(cnd) typedef char __CASSERT__[(cnd) ? 1 : -1]
+
+struct instruc_t
+{
+    const char* name;
+    uint32 feature;
+};
+
+#define CF_STOP 0x00001
+#define CF_CALL 0x00002
+#define CF_CHG1 0x00004
+#define CF_CHG2 0x00008
+#define CF_USE1 0x00100
+#define CF_USE2 0x00200
+#define CF_JUMP 0x04000
+
+#endif
@@ -0,0 +1,315 @@
+#include "dec.hpp"
+
+// One entry per opcode byte. ana() decodes straight from this table, so it is
+// the only place that knows how opcodes map to instructions and operands.
+const opcode_desc rgOpcodes[256] =
+{
+    { M8B_HALT,  opk_none,  opk_none,  1, 0,                   7 }, // 00h HALT
+    { M8B_ADD,   opk_A,     opk_imm,   2, OF_CF|OF_ZF,         4 }, // 01h ADD A,expr
+    { M8B_ADD,   opk_A,     opk_mem,   2, OF_CF|OF_ZF,         6 }, // 02h ADD A,[expr]
+    { M8B_ADD,   opk_A,     opk_displ, 2, OF_CF|OF_ZF,         7 }, // 03h ADD A,[X+expr]
+    { M8B_ADC,   opk_A,     opk_imm,   2, OF_CF|OF_ZF,         4 }, // 04h ADC A,expr
+    { M8B_ADC,   opk_A,     opk_mem,   2, OF_CF|OF_ZF,         6 }, // 05h ADC A,[expr]
+    { M8B_ADC,   opk_A,     opk_displ, 2, OF_CF|OF_ZF,         7 }, // 06h ADC A,[X+expr]
+    { M8B_SUB,   opk_A,     opk_imm,   2, OF_CF|OF_ZF,         4 }, // 07h SUB A,expr
+    { M8B_SUB,   opk_A,     opk_mem,   2, OF_CF|OF_ZF,         6 }, // 08h SUB A,[expr]
+    { M8B_SUB,   opk_A,     opk_displ, 2, OF_CF|OF_ZF,         7 }, // 09h SUB A,[X+expr]
+    { M8B_SBB,   opk_A,     opk_imm,   2, OF_CF|OF_ZF,         4 }, // 0Ah SBB A,expr
+    { M8B_SBB,   opk_A,     opk_mem,   2, OF_CF|OF_ZF,         6 }, // 0Bh SBB A,[expr]
+    { M8B_SBB,   opk_A,     opk_displ, 2, OF_CF|OF_ZF,         7 }, // 0Ch SBB A,[X+expr]
+    { M8B_OR,    opk_A,     opk_imm,   2, OF_CF0|OF_ZF,        4 }, // 0Dh OR A,expr
+    { M8B_OR,    opk_A,     opk_mem,   2, OF_CF0|OF_ZF,        6 }, // 0Eh OR A,[expr]
+    { M8B_OR,    opk_A,     opk_displ, 2, OF_CF0|OF_ZF,        7 }, // 0Fh OR A,[X+expr]
+    { M8B_AND,   opk_A,     opk_imm,   2, OF_CF0|OF_ZF,        4 }, // 10h AND A,expr
+    { M8B_AND,   opk_A,     opk_mem,   2, OF_CF0|OF_ZF,        6 }, // 11h AND A,[expr]
+    { M8B_AND,   opk_A,     opk_displ, 2, OF_CF0|OF_ZF,        7 }, // 12h AND A,[X+expr]
+    { M8B_XOR,   opk_A,     opk_imm,   2, OF_CF0|OF_ZF,        4 }, // 13h XOR A,expr
+    { M8B_XOR,   opk_A,     opk_mem,   2, OF_CF0|OF_ZF,        6 }, // 14h XOR A,[expr]
+    { M8B_XOR,   opk_A,     opk_displ, 2, OF_CF0|OF_ZF,        7 }, // 15h XOR A,[X+expr]
+    { M8B_CMP,   opk_A,     opk_imm,   2, OF_CF|OF_ZF,         5 }, // 16h CMP A,expr
+    { M8B_CMP,   opk_A,     opk_mem,   2, OF_CF|OF_ZF,         7 }, // 17h CMP A,[expr]
+    { M8B_CMP,   opk_A,     opk_displ, 2, OF_CF|OF_ZF,         8 }, // 18h CMP A,[X+expr]
+    { M8B_MOV,   opk_A,     opk_imm,   2, 0,                   4 }, // 19h MOV A,expr
+    { M8B_MOV,   opk_A,     opk_mem,   2, 0,                   5 }, // 1Ah MOV A,[expr]
+    { M8B_MOV,   opk_A,     opk_displ, 2, 0,                   6 }, // 1Bh MOV A,[X+expr]
+    { M8B_MOV,   opk_X,     opk_imm,   2, 0,                   4 }, // 1Ch MOV X,expr
+    { M8B_MOV,   opk_X,     opk_mem,   2, 0,                   5 }, // 1Dh MOV X,[expr]
+    { M8B_IPRET, opk_mem,   opk_none,  2, 0,                  13 }, // 1Eh IPRET addr
+    { M8B_XPAGE, opk_none,  opk_none,  1, 0,                   4 }, // 1Fh XPAGE
+    { M8B_NOP,   opk_none,  opk_none,  1, 0,                   4 }, // 20h NOP
+    { M8B_INC,   opk_A,     opk_none,  1, OF_CF|OF_ZF,         4 }, // 21h INC A
+    { M8B_INC,   opk_X,     opk_none,  1, OF_CF|OF_ZF,         4 }, // 22h INC X
+    { M8B_INC,   opk_mem,   opk_none,  2, OF_CF|OF_ZF,         7 }, // 23h INC [expr]
+    { M8B_INC,   opk_displ, opk_none,  2, OF_CF|OF_ZF,         8 }, // 24h INC [X+expr]
+    { M8B_DEC,   opk_A,     opk_none,  1, OF_CF|OF_ZF,         4 }, // 25h DEC A
+    { M8B_DEC,   opk_X,     opk_none,  1, OF_CF|OF_ZF,         4 }, // 26h DEC X
+    { M8B_DEC,   opk_mem,   opk_none,  2, OF_CF|OF_ZF,         7 }, // 27h DEC [expr]
+    { M8B_DEC,   opk_displ, opk_none,  2, OF_CF|OF_ZF,         8 }, // 28h DEC [X+expr]
+    { M8B_IORD,  opk_mem,   opk_none,  2, 0,                   5 }, // 29h IORD addr
+    { M8B_IOWR,  opk_mem,   opk_none,  2, 0,                   5 }, // 2Ah IOWR addr
+    { M8B_POP,   opk_A,     opk_none,  1, 0,                   4 }, // 2Bh POP A
+    { M8B_POP,   opk_X,     opk_none,  1, 0,                   4 }, // 2Ch POP X
+    { M8B_PUSH,  opk_A,     opk_none,  1, 0,                   5 }, // 2Dh PUSH A
+    { M8B_PUSH,  opk_X,     opk_none,  1, 0,                   5 }, // 2Eh PUSH X
+    { M8B_SWAP,  opk_A,     opk_X,     1, 0,                   5 }, // 2Fh SWAP A,X
+    { M8B_SWAP,  opk_A,     opk_DSP,   1, 0,                   5 }, // 30h SWAP A,DSP
+    { M8B_MOV,   opk_mem,   opk_A,     2, 0,                   5 }, // 31h MOV [expr],A
+    { M8B_MOV,   opk_displ, opk_A,     2, 0,                   6 }, // 32h MOV [X+expr],A
+    { M8B_OR,    opk_mem,   opk_A,     2, OF_CF0|OF_ZF,        7 }, // 33h OR [expr],A
+    { M8B_OR,    opk_displ, opk_A,     2, OF_CF0|OF_ZF,        8 }, // 34h OR [X+expr],A
+    { M8B_AND,   opk_mem,   opk_A,     2, OF_CF0|OF_ZF,        7 }, // 35h AND [expr],A
+    { M8B_AND,   opk_displ, opk_A,     2, OF_CF0|OF_ZF,        8 }, // 36h AND [X+expr],A
+    { M8B_XOR,   opk_mem,   opk_A,     2, OF_CF0|OF_ZF,        7 }, // 37h XOR [expr],A
+    { M8B_XOR,   opk_displ, opk_A,     2, OF_CF0|OF_ZF,        8 }, // 38h XOR [X+expr],A
+    { M8B_IOWX,  opk_displ, opk_none,  2, 0,                   6 }, // 39h IOWX [X+expr]
+    { M8B_CPL,   opk_A,     opk_none,  1, OF_CF1|OF_ZF,        4 }, // 3Ah CPL A
+    { M8B_ASL,   opk_A,     opk_none,  1, OF_CF|OF_ZF,         4 }, // 3Bh ASL A
+    { M8B_ASR,   opk_A,     opk_none,  1, OF_CF|OF_ZF,         4 }, // 3Ch ASR A
+    { M8B_RLC,   opk_A,     opk_none,  1, OF_CF|OF_ZF,         4 }, // 3Dh RLC A
+    { M8B_RRC,   opk_A,     opk_none,  1, OF_CF|OF_ZF,         4 }, // 3Eh RRC A
+    { M8B_RET,   opk_none,  opk_none,  1, 0,                   8 }, // 3Fh RET
+    { M8B_MOV,   opk_A,     opk_X,     1, 0,                   4 }, // 40h MOV A,X
+    { M8B_MOV,   opk_X,     opk_A,     1, 0,                   4 }, // 41h MOV X,A
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 42h
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 43h
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 44h
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 45h
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 46h
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 47h
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 48h
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 49h
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 4Ah
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 4Bh
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 4Ch
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 4Dh
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 4Eh
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 4Fh
+    { M8B_CALL,  opk_near1, opk_none,  2, 0,                  10 }, // 50h CALL addr
+    { M8B_CALL,  opk_near1, opk_none,  2, 0,                  10 }, // 51h CALL addr
+    { M8B_CALL,  opk_near1, opk_none,  2, 0,                  10 }, // 52h CALL addr
+    { M8B_CALL,  opk_near1, opk_none,  2, 0,                  10 }, // 53h CALL addr
+    { M8B_CALL,  opk_near1, opk_none,  2, 0,                  10 }, // 54h CALL addr
+    { M8B_CALL,  opk_near1, opk_none,  2, 0,                  10 }, // 55h CALL addr
+    { M8B_CALL,  opk_near1, opk_none,  2, 0,                  10 }, // 56h CALL addr
+    { M8B_CALL,  opk_near1, opk_none,  2, 0,                  10 }, // 57h CALL addr
+    { M8B_CALL,  opk_near1, opk_none,  2, 0,                  10 }, // 58h CALL addr
+    { M8B_CALL,  opk_near1, opk_none,  2, 0,                  10 }, // 59h CALL addr
+    { M8B_CALL,  opk_near1, opk_none,  2, 0,                  10 }, // 5Ah CALL addr
+    { M8B_CALL,  opk_near1, opk_none,  2, 0,                  10 }, // 5Bh CALL addr
+    { M8B_CALL,  opk_near1, opk_none,  2, 0,                  10 }, // 5Ch CALL addr
+    { M8B_CALL,  opk_near1, opk_none,  2, 0,                  10 }, // 5Dh CALL addr
+    { M8B_CALL,  opk_near1, opk_none,  2, 0,                  10 }, // 5Eh CALL addr
+    { M8B_CALL,  opk_near1, opk_none,  2, 0,                  10 }, // 5Fh CALL addr
+    { M8B_MOV,   opk_PSP,   opk_A,     1, 0,                   4 }, // 60h MOV PSP,A
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 61h
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 62h
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 63h
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 64h
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 65h
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 66h
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 67h
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 68h
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 69h
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 6Ah
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 6Bh
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 6Ch
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 6Dh
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 6Eh
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 6Fh
+    { M8B_DI,    opk_none,  opk_none,  1, OF_IE0,              4 }, // 70h DI
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 71h
+    { M8B_EI,    opk_none,  opk_none,  1, OF_IE1,              4 }, // 72h EI
+    { M8B_RETI,  opk_none,  opk_none,  1, OF_CF|OF_ZF|OF_IE1,  8 }, // 73h RETI
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 74h
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 75h
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 76h
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 77h
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 78h
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 79h
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 7Ah
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 7Bh
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 7Ch
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 7Dh
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 7Eh
+    { M8B_null,  opk_none,  opk_none,  0, 0,                   0 }, // 7Fh
+    { M8B_JMP,   opk_near,  opk_none,  2, 0,                   5 }, // 80h JMP addr
+    { M8B_JMP,   opk_near,  opk_none,  2, 0,                   5 }, // 81h JMP addr
+    { M8B_JMP,   opk_near,  opk_none,  2, 0,                   5 }, // 82h JMP addr
+    { M8B_JMP,   opk_near,  opk_none,  2, 0,                   5 }, // 83h JMP addr
+    { M8B_JMP,   opk_near,  opk_none,  2, 0,                   5 }, // 84h JMP addr
+    { M8B_JMP,   opk_near,  opk_none,  2, 0,                   5 }, // 85h JMP addr
+    { M8B_JMP,   opk_near,  opk_none,  2, 0,                   5 }, // 86h JMP addr
+    { M8B_JMP,   opk_near,  opk_none,  2, 0,                   5 }, // 87h JMP addr
+    { M8B_JMP,   opk_near,  opk_none,  2, 0,                   5 }, // 88h JMP addr
+    { M8B_JMP,   opk_near,  opk_none,  2, 0,                   5 }, // 89h JMP addr
+    { M8B_JMP,   opk_near,  opk_none,  2, 0,                   5 }, // 8Ah JMP addr
+    { M8B_JMP,   opk_near,  opk_none,  2, 0,                   5 }, // 8Bh JMP addr
+    { M8B_JMP,   opk_near,  opk_none,  2, 0,                   5 }, // 8Ch JMP addr
+    { M8B_JMP,   opk_near,  opk_none,  2, 0,                   5 }, // 8Dh JMP addr
+    { M8B_JMP,   opk_near,  opk_none,  2, 0,                   5 }, // 8Eh JMP addr
+    { M8B_JMP,   opk_near,  opk_none,  2, 0,                   5 }, // 8Fh JMP addr
+    { M8B_CALL,  opk_near,  opk_none,  2, 0,                  10 }, // 90h CALL addr
+    { M8B_CALL,  opk_near,  opk_none,  2, 0,                  10 }, // 91h CALL addr
+    { M8B_CALL,  opk_near,  opk_none,  2, 0,                  10 }, // 92h CALL addr
+    { M8B_CALL,  opk_near,  opk_none,  2, 0,                  10 }, // 93h CALL addr
+    { M8B_CALL,  opk_near,  opk_none,  2, 0,                  10 }, // 94h CALL addr
+    { M8B_CALL,  opk_near,  opk_none,  2, 0,                  10 }, // 95h CALL addr
+    { M8B_CALL,  opk_near,  opk_none,  2, 0,                  10 }, // 96h CALL addr
+    { M8B_CALL,  opk_near,  opk_none,  2, 0,                  10 }, // 97h CALL addr
+    { M8B_CALL,  opk_near,  opk_none,  2, 0,                  10 }, // 98h CALL addr
+    { M8B_CALL,  opk_near,  opk_none,  2, 0,                  10 }, // 99h CALL addr
+    { M8B_CALL,  opk_near,  opk_none,  2, 0,                  10 }, // 9Ah CALL addr
+    { M8B_CALL,  opk_near,  opk_none,  2, 0,                  10 }, // 9Bh CALL addr
+    { M8B_CALL,  opk_near,  opk_none,  2, 0,                  10 }, // 9Ch CALL addr
+    { M8B_CALL,  opk_near,  opk_none,  2, 0,                  10 }, // 9Dh CALL addr
+    { M8B_CALL,  opk_near,  opk_none,  2, 0,                  10 }, // 9Eh CALL addr
+    { M8B_CALL,  opk_near,  opk_none,  2, 0,                  10 }, // 9Fh CALL addr
+    { M8B_JZ,    opk_near,  opk_none,  2, 0,                   5 }, // A0h JZ addr
+    { M8B_JZ,    opk_near,  opk_none,  2, 0,                   5 }, // A1h JZ addr
+    { M8B_JZ,    opk_near,  opk_none,  2, 0,                   5 }, // A2h JZ addr
+    { M8B_JZ,    opk_near,  opk_none,  2, 0,                   5 }, // A3h JZ addr
+    { M8B_JZ,    opk_near,  opk_none,  2, 0,                   5 }, // A4h JZ addr
+    { M8B_JZ,    opk_near,  opk_none,  2, 0,                   5 }, // A5h JZ addr
+    { M8B_JZ,    opk_near,  opk_none,  2, 0,                   5 }, // A6h JZ addr
+    { M8B_JZ,    opk_near,  opk_none,  2, 0,                   5 }, // A7h JZ addr
+    { M8B_JZ,    opk_near,  opk_none,  2, 0,                   5 }, // A8h JZ addr
+    { M8B_JZ,    opk_near,  opk_none,  2, 0,                   5 }, // A9h JZ addr
+    { M8B_JZ,    opk_near,  opk_none,  2, 0,                   5 }, // AAh JZ addr
+    { M8B_JZ,    opk_near,  opk_none,  2, 0,                   5 }, // ABh JZ addr
+    { M8B_JZ,    opk_near,  opk_none,  2, 0,                   5 }, // ACh JZ addr
+    { M8B_JZ,    opk_near,  opk_none,  2, 0,                   5 }, // ADh JZ addr
+    { M8B_JZ,    opk_near,  opk_none,  2, 0,                   5 }, // AEh JZ addr
+    { M8B_JZ,    opk_near,  opk_none,  2, 0,                   5 }, // AFh JZ addr
+    { M8B_JNZ,   opk_near,  opk_none,  2, 0,                   5 }, // B0h JNZ addr
+    { M8B_JNZ,   opk_near,  opk_none,  2, 0,                   5 }, // B1h JNZ addr
+    { M8B_JNZ,   opk_near,  opk_none,  2, 0,                   5 }, // B2h JNZ addr
+    { M8B_JNZ,   opk_near,  opk_none,  2, 0,                   5 }, // B3h JNZ addr
+    { M8B_JNZ,   opk_near,  opk_none,  2, 0,                   5 }, // B4h JNZ addr
+    { M8B_JNZ,   opk_near,  opk_none,  2, 0,                   5 }, // B5h JNZ addr
+    { M8B_JNZ,   opk_near,  opk_none,  2, 0,                   5 }, // B6h JNZ addr
+    { M8B_JNZ,   opk_near,  opk_none,  2, 0,                   5 }, // B7h JNZ addr
+    { M8B_JNZ,   opk_near,  opk_none,  2, 0,                   5 }, // B8h JNZ addr
+    { M8B_JNZ,   opk_near,  opk_none,  2, 0,                   5 }, // B9h JNZ addr
+    { M8B_JNZ,   opk_near,  opk_none,  2, 0,                   5 }, // BAh JNZ addr
+    { M8B_JNZ,   opk_near,  opk_none,  2, 0,                   5 }, // BBh JNZ addr
+    { M8B_JNZ,   opk_near,  opk_none,  2, 0,                   5 }, // BCh JNZ addr
+    { M8B_JNZ,   opk_near,  opk_none,  2, 0,                   5 }, // BDh JNZ addr
+    { M8B_JNZ,   opk_near,  opk_none,  2, 0,                   5 }, // BEh JNZ addr
+    { M8B_JNZ,   opk_near,  opk_none,  2, 0,                   5 }, // BFh JNZ addr
+    { M8B_JC,    opk_near,  opk_none,  2, 0,                   5 }, // C0h JC addr
+    { M8B_JC,    opk_near,  opk_none,  2, 0,                   5 }, // C1h JC addr
+    { M8B_JC,    opk_near,  opk_none,  2, 0,                   5 }, // C2h JC addr
+    { M8B_JC,    opk_near,  opk_none,  2, 0,                   5 }, // C3h JC addr
+    { M8B_JC,    opk_near,  opk_none,  2, 0,                   5 }, // C4h JC addr
+    { M8B_JC,    opk_near,  opk_none,  2, 0,                   5 }, // C5h JC addr
+    { M8B_JC,    opk_near,  opk_none,  2, 0,                   5 }, // C6h JC addr
+    { M8B_JC,    opk_near,  opk_none,  2, 0,                   5 }, // C7h JC addr
+    { M8B_JC,    opk_near,  opk_none,  2, 0,                   5 }, // C8h JC addr
+    { M8B_JC,    opk_near,  opk_none,  2, 0,                   5 }, // C9h JC addr
+    { M8B_JC,    opk_near,  opk_none,  2, 0,                   5 }, // CAh JC addr
+    { M8B_JC,    opk_near,  opk_none,  2, 0,                   5 }, // CBh JC addr
+    { M8B_JC,    opk_near,  opk_none,  2, 0,                   5 }, // CCh JC addr
+    { M8B_JC,    opk_near,  opk_none,  2, 0,                   5 }, // CDh JC addr
+    { M8B_JC,    opk_near,  opk_none,  2, 0,                   5 }, // CEh JC addr
+    { M8B_JC,    opk_near,  opk_none,  2, 0,                   5 }, // CFh JC addr
+    { M8B_JNC,   opk_near,  opk_none,  2, 0,                   5 }, // D0h JNC addr
+    { M8B_JNC,   opk_near,  opk_none,  2, 0,                   5 }, // D1h JNC addr
+    { M8B_JNC,   opk_near,  opk_none,  2, 0,                   5 }, // D2h JNC addr
+    { M8B_JNC,   opk_near,  opk_none,  2, 0,                   5 }, // D3h JNC addr
+    { M8B_JNC,   opk_near,  opk_none,  2, 0,                   5 }, // D4h JNC addr
+    { M8B_JNC,   opk_near,  opk_none,  2, 0,                   5 }, // D5h JNC addr
+    { M8B_JNC,   opk_near,  opk_none,  2, 0,                   5 }, // D6h JNC addr
+    { M8B_JNC,   opk_near,  opk_none,  2, 0,                   5 }, // D7h JNC addr
+    { M8B_JNC,   opk_near,  opk_none,  2, 0,                   5 }, // D8h JNC addr
+    { M8B_JNC,   opk_near,  opk_none,  2, 0,                   5 }, // D9h JNC addr
+    { M8B_JNC,   opk_near,  opk_none,  2, 0,                   5 }, // DAh JNC addr
+    { M8B_JNC,   opk_near,  opk_none,  2, 0,                   5 }, // DBh JNC addr
+    { M8B_JNC,   opk_near,  opk_none,  2, 0,                   5 }, // DCh JNC addr
+    { M8B_JNC,   opk_near,  opk_none,  2, 0,                   5 }, // DDh JNC addr
+    { M8B_JNC,   opk_near,  opk_none,  2, 0,                   5 }, // DEh JNC addr
+    { M8B_JNC,   opk_near,  opk_none,  2, 0,                   5 }, // DFh JNC addr
+    { M8B_JACC,  opk_near,  opk_none,  2, OF_CF|OF_ZF,         7 }, // E0h JACC addr
+    { M8B_JACC,  opk_near,  opk_none,  2, OF_CF|OF_ZF,         7 }, // E1h JACC addr
+    { M8B_JACC,  opk_near,  opk_none,  2, OF_CF|OF_ZF,         7 }, // E2h JACC addr
+    { M8B_JACC,  opk_near,  opk_none,  2, OF_CF|OF_ZF,         7 }, // E3h JACC addr
+    { M8B_JACC,  opk_near,  opk_none,  2, OF_CF|OF_ZF,         7 }, // E4h JACC addr
+    { M8B_JACC,  opk_near,  opk_none,  2, OF_CF|OF_ZF,         7 }, // E5h JACC addr
+    { M8B_JACC,  opk_near,  opk_none,  2, OF_CF|OF_ZF,         7 }, // E6h JACC addr
+    { M8B_JACC,  opk_near,  opk_none,  2, OF_CF|OF_ZF,         7 }, // E7h JACC addr
+    { M8B_JACC,  opk_near,  opk_none,  2, OF_CF|OF_ZF,         7 }, // E8h JACC addr
+    { M8B_JACC,  opk_near,  opk_none,  2, OF_CF|OF_ZF,         7 }, // E9h JACC addr
+    { M8B_JACC,  opk_near,  opk_none,  2, OF_CF|OF_ZF,         7 }, // EAh JACC addr
+    { M8B_JACC,  opk_near,  opk_none,  2, OF_CF|OF_ZF,         7 }, // EBh JACC addr
+    { M8B_JACC,  opk_near,  opk_none,  2, OF_CF|OF_ZF,         7 }, // ECh JACC addr
+    { M8B_JACC,  opk_near,  opk_none,  2, OF_CF|OF_ZF,         7 }, // EDh JACC addr
+    { M8B_JACC,  opk_near,  opk_none,  2, OF_CF|OF_ZF,         7 }, // EEh JACC addr
+    { M8B_JACC,  opk_near,  opk_none,  2, OF_CF|OF_ZF,         7 }, // EFh JACC addr
+    { M8B_INDEX, opk_near,  opk_none,  2, OF_CF|OF_ZF,        14 }, // F0h INDEX addr
+    { M8B_INDEX, opk_near,  opk_none,  2, OF_CF|OF_ZF,        14 }, // F1h INDEX addr
+    { M8B_INDEX, opk_near,  opk_none,  2, OF_CF|OF_ZF,        14 }, // F2h INDEX addr
+    { M8B_INDEX, opk_near,  opk_none,  2, OF_CF|OF_ZF,        14 }, // F3h INDEX addr
+    { M8B_INDEX, opk_near,  opk_none,  2, OF_CF|OF_ZF,        14 }, // F4h INDEX addr
+    { M8B_INDEX, opk_near,  opk_none,  2, OF_CF|OF_ZF,        14 }, // F5h INDEX addr
+    { M8B_INDEX, opk_near,  opk_none,  2, OF_CF|OF_ZF,        14 }, // F6h INDEX addr
+    { M8B_INDEX, opk_near,  opk_none,  2, OF_CF|OF_ZF,        14 }, // F7h INDEX addr
+    { M8B_INDEX, opk_near,  opk_none,  2, OF_CF|OF_ZF,        14 }, // F8h INDEX addr
+    { M8B_INDEX, opk_near,  opk_none,  2, OF_CF|OF_ZF,        14 }, // F9h INDEX addr
+    { M8B_INDEX, opk_near,  opk_none,  2, OF_CF|OF_ZF,        14 }, // FAh INDEX addr
+    { M8B_INDEX, opk_near,  opk_none,  2, OF_CF|OF_ZF,        14 }, // FBh INDEX addr
+    { M8B_INDEX, opk_near,  opk_none,  2, OF_CF|OF_ZF,        14 }, // FCh INDEX addr
+    { M8B_INDEX, opk_near,  opk_none,  2, OF_CF|OF_ZF,        14 }, // FDh INDEX addr
+    { M8B_INDEX, opk_near,  opk_none,  2, OF_CF|OF_ZF,        14 }, // FEh INDEX addr
+    { M8B_INDEX, opk_near,  opk_none,  2, OF_CF|OF_ZF,        14 }, // FFh INDEX addr
+};
+
+CASSERT(qnumber(rgOpcodes) == 256);
+
+static size_t operand_size(uint8 kind)
+{
+    switch (kind)
+    {
+    case opk_imm:
+    case opk_mem:
+    case opk_displ:
+    case opk_near:
+    case opk_near1:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+// Verify that the table agrees with the feature flags in rgInstructions
+bool check_opcodes()
+{
+    const opcode_desc* pOpcode;
+    uint32 dwFeature;
+    size_t i;
+    bool fOk = true;
+
+    for (i = 0; i < qnumber(rgOpcodes); ++i)
+    {
+        pOpcode = rgOpcodes + i;
+
+        if (pOpcode->itype == M8B_null)
+        {
+            if (pOpcode->size || pOpcode->op1 || pOpcode->op2) fOk = false;
+            continue;
+        }
+
+        if (pOpcode->itype >= M8B_last || pOpcode->size != 1 + operand_size(pOpcode->op1) + operand_size(pOpcode->op2))
+        {
+            fOk = false;
+            continue;
+        }
+
+        dwFeature = rgInstructions[pOpcode->itype].feature;
+
+        if ((pOpcode->op1 != opk_none) != ((dwFeature & (CF_USE1|CF_CHG1)) != 0)) fOk = false;
+        if (pOpcode->op2 != opk_none && !(dwFeature & CF_USE2)) fOk = false;
+        if (pOpcode->op2 == opk_none && (dwFeature & (CF_USE2|CF_CHG2))) fOk = false;
+        if ((dwFeature & (CF_CALL|CF_JUMP)) && pOpcode->op1 != opk_near && pOpcode->op1 != opk_near1) fOk = false;
+    }
+
+    return fOk;
+}
@@ -0,0 +1,42 @@
+#ifndef OPC_HPP_INCLUDED
+#define OPC_HPP_INCLUDED
+
+// Operand shapes
+enum opkind_t ENUM_SIZE(uint8)
+{
+    opk_none = 0,   // no operand
+    opk_A,          // A
+    opk_X,          // X
+    opk_DSP,        // DSP
+    opk_PSP,        // PSP
+    opk_imm,        // expr
+    opk_mem,        // [expr]
+    opk_displ,      // [X+expr]
+    opk_near,       // addr, bits 8-11 taken from the opcode
+    opk_near1       // addr in the upper 4K (CALL 50h-5Fh)
+};
+
+// Flag effects
+#define OF_CF   0x01    // carry flag is updated
+#define OF_ZF   0x02    // zero flag is updated
+#define OF_CF0  0x04    // carry flag is cleared
+#define OF_CF1  0x08    // carry flag is set
+#define OF_IE0  0x10    // interrupts are disabled
+#define OF_IE1  0x20    // interrupts are enabled
+
+typedef struct opcode_desc_t
+{
+    uint8 itype;        // instructno_t, M8B_null for unused opcodes
+    uint8 op1;          // opkind_t
+    uint8 op2;          // opkind_t
+    uint8 size;         // instruction length in bytes, 0 for unused opcodes
+    uint8 flags;        // OF_xxx
+    uint8 cycles;       // CPU cycles (CY7C637xx data sheet)
+}
+opcode_desc;
+
+extern const opcode_desc rgOpcodes[256];
+
+bool check_opcodes();
+
+#endif
@@ -1,5 +1,48 @@
 #include "m8b.hpp"
 
+#define OUTCACHE_LINES 0x400    // direct mapped by address, a few screens of listing
+#define OUTCACHE_TEXT  96       // longer operands are rendered every time
+
+// Rendered name operands (RAM, ports, jump targets) and the ORG check of a line,
+// so repainting lines that did not change skips the name lookups. The operand
+// type and address are kept to notice reanalysis; renames, patches, operand
+// type and device changes clear everything (invalidate_out_cache).
+typedef struct out_cache_line_t
+{
+    ea_t ea;                    // BADADDR when unused
+    ea_t rgAddr[2];
+    uchar rgType[2];            // o_void when the operand is not cached
+    char rgszText[2][OUTCACHE_TEXT];
+    bool fOrgKnown;
+    bool fOrg;
+}
+out_cache_line;
+
+static out_cache_line rgOutCache[OUTCACHE_LINES];
+
+static out_cache_line* get_out_cache(ea_t ea);
+
+void invalidate_out_cache()
+{
+    size_t i;
+
+    for (i = 0; i < qnumber(rgOutCache); ++i)
+        rgOutCache[i].ea = BADADDR;
+}
+
+static out_cache_line* get_out_cache(ea_t ea)
+{
+    out_cache_line* pLine = rgOutCache + ea % OUTCACHE_LINES;
+
+    if (pLine->ea != ea)
+    {
+        pLine->ea = ea;
+        pLine->rgType[0] = pLine->rgType[1] = o_void;
+        pLine->fOrgKnown = false;
+    }
+    return pLine;
+}
+
 static void out_bad_address(ea_t addr)
 {
     out_tagon(COLOR_ERROR);
@@ -11,9 +54,23 @@ static void out_bad_address(ea_t addr)
 bool idaapi outop(op_t& x)
 {
     char szValue[MAXSTR];
+    out_cache_line* pLine = NULL;
     const char* szSymbol;
+    char* pchStart = NULL;
+    bool fName = false;
     ea_t ea;
 
+    if (x.n < 2 && (x.type == o_mem || x.type == o_displ || x.type == o_near))
+    {
+        pLine = get_out_cache(cmd.ea);
+        if (pLine->rgType[x.n] == x.type && pLine->rgAddr[x.n] == x.addr)
+        {
+            OutLine(pLine->rgszText[x.n]);
+            return true;
+        }
+        pchStart = get_output_ptr();
+    }
+
     switch (x.type)
     {
     case o_void:
@@ -40,6 +97,7 @@ bool idaapi outop(op_t& x)
             {
                 out_addr_tag(cmd.ea);
                 out_line(szSymbol, COLOR_IMPNAME);
+                fName = true;
             }
             else
                 OutValue(x, OOF_ADDR | OOFS_NOSIGN | OOFW_IMM);
@@ -50,7 +108,10 @@ bool idaapi outop(op_t& x)
             if (ea == BADADDR)
                 out_bad_address(x.addr);
             else if (get_name_expr(cmd.ea + x.offb, x.n, ea, x.addr, szValue, sizeof(szValue)) > 0)
+            {
                 OutLine(szValue);
+                fName = true;
+            }
             else
                 OutValue(x, OOF_ADDR | OOFS_NOSIGN | OOFW_IMM);
         }
@@ -71,7 +132,10 @@ bool idaapi outop(op_t& x)
             if (ea == BADADDR)
                 out_bad_address(x.addr);
             else if (get_name_expr(cmd.ea + x.offb, x.n, ea, x.addr, szValue, sizeof(szValue)) > 0)
+            {
                 OutLine(szValue);
+                fName = true;
+            }
             else
                 OutValue(x, OOF_ADDR | OOFS_NOSIGN | OOFW_IMM);
             break;
@@ -82,7 +146,10 @@ bool idaapi outop(op_t& x)
             if (ea == BADADDR)
                 out_bad_address(x.addr);
             else if (get_name_expr(cmd.ea + x.offb, x.n, ea, x.addr, szValue, sizeof(szValue)) > 0)
+            {
                 OutLine(szValue);
+                fName = true;
+            }
             else
                 OutValue(x, OOF_ADDR | OOFS_NOSIGN | OOFW_IMM);
             out_symbol(']');
@@ -99,23 +166,42 @@ bool idaapi outop(op_t& x)
             QueueMark(Q_noName, cmd.ea);
         }
         else
+        {
             OutLine(szValue);
+            fName = true;
+        }
         break;
 
      default:
          warning("out: %a: bad optype %d", cmd.ea, x.type);
     }
 
+    // Only names are kept, plain values may still get one
+    if (pLine && fName && get_output_ptr() - pchStart < OUTCACHE_TEXT)
+    {
+        qstrncpy(pLine->rgszText[x.n], pchStart, get_output_ptr() - pchStart + 1);
+        pLine->rgAddr[x.n] = x.addr;
+        pLine->rgType[x.n] = x.type;
+    }
+
     return true;
 }
 
 void idaapi out()
 {
     char szLine[MAXSTR];
+    out_cache_line* pLine;
 
     init_output_buffer(szLine, sizeof(szLine));
 
-    if (!has_any_name(uFlag) && helper.altval(cmd.ea))
+    pLine = get_out_cache(cmd.ea);
+    if (!pLine->fOrgKnown)
+    {
+        pLine->fOrg = helper.altval(cmd.ea) != 0;
+        pLine->fOrgKnown = true;
+    }
+
+    if (!has_any_name(uFlag) && pLine->fOrg)
     {
         btoa(szLine, sizeof(szLine), cmd.ip);
         printf_line(inf.indent, COLSTR("%s %s", SCOLOR_ASMDIR), ash.origin, szLine);
@@ -0,0 +1,381 @@
+#include "dec.hpp"
+
+// Whole ROM propagation of the register values m8b_track() knows about.
+// The entry state of each basic block is the meet of everything that flows,
+// jumps or calls into it and is kept in the helper netnode, so get_regstate()
+// can start a block with it. Subroutines get a summary of the registers they
+// change and the values they return with. emu() reports the instructions it
+// sees and propagate() revisits their functions once the queues are empty.
+#define TAG_ENTRY    'R'        // m8b_regstate at a block start
+#define TAG_SUMMARY  'F'        // call_summary at a subroutine start
+#define MAXSTEPS     0x10000    // blocks processed per run
+
+typedef struct call_summary_t
+{
+    uint8 fWrites;              // M8B_RS_xxx the subroutine and its callees may change
+    uint8 fReturns;             // ret is the meet of the states at its returns
+    uint8 reserved[6];
+    m8b_regstate ret;
+}
+call_summary;
+
+// Block entries touched by a run and their state before it
+typedef struct entry_change_t
+{
+    ea_t ea;
+    ea_t eaEnd;
+    bool fHad;
+    m8b_regstate state;
+}
+entry_change;
+
+static qvector<ea_t> qvDirty;
+static qvector<ea_t> qvWork;
+static qvector<entry_change> qvChanges;
+static qvector<uchar> qvTouched;    // per ROM byte: entry already in qvChanges
+static area_t areaROM;
+
+static bool get_summary(ea_t ea, call_summary* pSummary);
+static void note_change(ea_t ea, const m8b_regstate* pOld);
+static void set_block_end(ea_t ea, ea_t eaEnd);
+static void contribute(ea_t ea, const m8b_regstate* pState);
+static void seed(ea_t ea);
+static void reset_function(const func_t* pFunc);
+static void process_block(ea_t eaStart);
+static void queue_callers(ea_t eaFunc);
+static bool same_state(const m8b_regstate* p1, const m8b_regstate* p2);
+
+void mark_dirty(ea_t ea)
+{
+    qvDirty.push_back(ea);
+}
+
+void reset_propagation()
+{
+    qvDirty.clear();
+    qvWork.clear();
+    qvChanges.clear();
+    qvTouched.clear();
+}
+
+bool get_block_entry(ea_t ea, m8b_regstate* pState)
+{
+    if (helper.supval(ea, pState, sizeof(*pState), TAG_ENTRY) == sizeof(*pState))
+        return true;
+
+    memset(pState, 0, sizeof(*pState));
+    return false;
+}
+
+// Registers the subroutine writes are replaced with what it returns, the rest
+// is kept. Before its summary is there, its effect (call.cpp) still tells what
+// it leaves alone and where it leaves the data stack.
+void apply_call_summary(m8b_regstate* pState, ea_t eaCallee)
+{
+    call_summary summary;
+    m8b_call_effect effect;
+    uint8 fSet;
+    bool fDSP;
+
+    if (eaCallee == BADADDR || !get_summary(eaCallee, &summary))
+    {
+        if (eaCallee == BADADDR || !get_call_effect(eaCallee, &effect))
+        {
+            pState->flags = 0;
+            return;
+        }
+
+        fDSP = (pState->flags & M8B_RS_DSP) != 0;
+        pState->flags &= ~effect.fWrites;
+        if (fDSP && !(effect.flags & (M8B_CE_UNBOUNDED | M8B_CE_PARTIAL | M8B_CE_RESET | M8B_CE_UNEVEN)))
+        {
+            pState->flags |= M8B_RS_DSP;
+            pState->dsp -= effect.nNet;
+        }
+        return;
+    }
+
+    fSet = summary.fReturns ? summary.ret.flags & summary.fWrites & ~M8B_RS_APORT : 0;
+    pState->flags = (pState->flags & ~summary.fWrites) | fSet;
+
+    if (fSet & M8B_RS_A) pState->a = summary.ret.a;
+    if (fSet & M8B_RS_X) pState->x = summary.ret.x;
+    if (fSet & M8B_RS_DSP) pState->dsp = summary.ret.dsp;
+    if (fSet & M8B_RS_PSP) pState->psp = summary.ret.psp;
+}
+
+void propagate()
+{
+    qvector<ea_t> qvFuncs;
+    segment_t* pSegment;
+    entry_change* pChange;
+    m8b_regstate state;
+    func_t* pFunc;
+    size_t i, nSteps;
+    ea_t ea;
+
+    if (qvDirty.empty())
+        return;
+
+    pSegment = segROM();
+    if (!pSegment)
+    {
+        qvDirty.clear();
+        return;
+    }
+
+    areaROM.startEA = pSegment->startEA;
+    areaROM.endEA = pSegment->endEA;
+    qvTouched.resize(0);
+    qvTouched.resize(areaROM.endEA - areaROM.startEA, 0);
+
+    for (i = 0; i < qvDirty.size(); ++i)
+    {
+        pFunc = get_func(qvDirty[i]);
+        if (pFunc)
+            qvFuncs.add_unique(pFunc->startEA);
+        else
+            seed(find_block_start(qvDirty[i]));
+    }
+    qvDirty.clear();
+    update_call_effects(qvFuncs);
+
+    for (i = 0; i < qvFuncs.size(); ++i)
+    {
+        pFunc = get_func(qvFuncs[i]);
+        if (!pFunc) continue;
+        reset_function(pFunc);
+        seed(pFunc->startEA);
+    }
+
+    for (nSteps = 0; !qvWork.empty() && nSteps < MAXSTEPS; ++nSteps)
+    {
+        ea = qvWork.back();
+        qvWork.pop_back();
+        process_block(ea);
+    }
+    qvWork.clear();
+
+    // Have emu() look at every block whose entry state came out different
+    for (i = 0; i < qvChanges.size(); ++i)
+    {
+        pChange = &qvChanges[i];
+        if (get_block_entry(pChange->ea, &state) != pChange->fHad || !same_state(&state, &pChange->state))
+            auto_mark_range(pChange->ea, pChange->eaEnd, AU_USED);
+    }
+
+    qvChanges.clear();
+    qvTouched.clear();
+    invalidate_regstates();
+}
+
+static bool get_summary(ea_t ea, call_summary* pSummary)
+{
+    if (helper.supval(ea, pSummary, sizeof(*pSummary), TAG_SUMMARY) == sizeof(*pSummary))
+        return true;
+
+    memset(pSummary, 0, sizeof(*pSummary));
+    return false;
+}
+
+// Remember the state of a block entry the first time a run changes it
+static void note_change(ea_t ea, const m8b_regstate* pOld)
+{
+    entry_change change;
+    size_t n;
+
+    if (!areaROM.contains(ea))
+        return;
+
+    n = ea - areaROM.startEA;
+    if (qvTouched[n])
+        return;
+
+    qvTouched[n] = 1;
+    change.ea = ea;
+    change.eaEnd = ea + 1;
+    change.fHad = pOld != NULL;
+    if (pOld) change.state = *pOld; else memset(&change.state, 0, sizeof(change.state));
+    qvChanges.push_back(change);
+}
+
+static void set_block_end(ea_t ea, ea_t eaEnd)
+{
+    size_t i;
+
+    if (!areaROM.contains(ea) || !qvTouched[ea - areaROM.startEA])
+        return;
+
+    for (i = qvChanges.size(); i-- > 0; )
+    {
+        if (qvChanges[i].ea == ea)
+        {
+            qvChanges[i].eaEnd = eaEnd;
+            break;
+        }
+    }
+}
+
+// Merge pState into the entry of the block at ea and queue it if that changed
+static void contribute(ea_t ea, const m8b_regstate* pState)
+{
+    m8b_regstate state, old;
+
+    if (!isCode(getFlags(ea)))
+        return;
+
+    if (get_block_entry(ea, &state))
+    {
+        old = state;
+        if (!m8b_meet(&state, pState)) return;
+        note_change(ea, &old);
+    }
+    else
+    {
+        note_change(ea, NULL);
+        state = *pState;
+    }
+
+    helper.supset(ea, &state, sizeof(state), TAG_ENTRY);
+    qvWork.push_back(ea);
+}
+
+// Queue a block. Blocks nothing refers to (entry points, vectors) start with
+// nothing known; the others wait for their predecessors.
+static void seed(ea_t ea)
+{
+    m8b_regstate state;
+
+    if (get_block_entry(ea, &state))
+        qvWork.push_back(ea);
+    else if (get_first_cref_to(ea) == BADADDR)
+        contribute(ea, &state);
+}
+
+// Forget everything inside a changed subroutine except its entry and revisit
+// the code outside it that jumps in
+static void reset_function(const func_t* pFunc)
+{
+    m8b_regstate state;
+    nodeidx_t idx, idxNext;
+    ea_t eaFrom;
+
+    for (idx = helper.supnxt(pFunc->startEA, TAG_ENTRY); idx != BADNODE && idx < pFunc->endEA; idx = idxNext)
+    {
+        idxNext = helper.supnxt(idx, TAG_ENTRY);
+
+        for (eaFrom = get_first_fcref_to(idx); eaFrom != BADADDR; eaFrom = get_next_fcref_to(idx, eaFrom))
+        {
+            if (!pFunc->contains(eaFrom))
+                seed(find_block_start(eaFrom));
+        }
+
+        get_block_entry(idx, &state);
+        note_change(idx, &state);
+        helper.supdel(idx, TAG_ENTRY);
+    }
+
+    helper.supdel(pFunc->startEA, TAG_SUMMARY);
+}
+
+// Track a block from its entry state into its successors and its subroutine's
+// summary
+static void process_block(ea_t eaStart)
+{
+    m8b_regstate state, callee;
+    call_summary summary, old, sub;
+    m8b_insn insn;
+    func_t* pFunc;
+    ea_t ea, eaNext, eaTo, eaFunc;
+
+    if (!get_block_entry(eaStart, &state))
+        return;
+
+    pFunc = get_func(eaStart);
+    eaFunc = pFunc ? pFunc->startEA : BADADDR;
+    if (eaFunc != BADADDR) get_summary(eaFunc, &summary); else memset(&summary, 0, sizeof(summary));
+
+    for (ea = eaNext = eaStart; isCode(getFlags(ea)) && decode_rom(ea, &insn); ea = eaNext)
+    {
+        eaNext = ea + insn.size;
+
+        if (insn.itype == M8B_CALL)
+        {
+            eaTo = toROM(insn.addr);
+            callee = state;
+            if (callee.flags & M8B_RS_PSP) callee.psp += 2;
+            if (eaTo != BADADDR) contribute(eaTo, &callee);
+
+            summary.fWrites |= eaTo != BADADDR && get_summary(eaTo, &sub) ? sub.fWrites : M8B_RS_ALL;
+        }
+        else
+            summary.fWrites |= m8b_writes(&insn);
+
+        track_insn(&state, &insn);
+
+        if (insn.itype != M8B_CALL)
+        {
+            for (eaTo = get_first_fcref_from(ea); eaTo != BADADDR; eaTo = get_next_fcref_from(ea, eaTo))
+                contribute(eaTo, &state);
+        }
+
+        if (insn.itype == M8B_RET || insn.itype == M8B_RETI)
+        {
+            if (summary.fReturns) m8b_meet(&summary.ret, &state); else summary.ret = state;
+            summary.fReturns = 1;
+        }
+
+        if (rgInstructions[insn.itype].feature & CF_STOP)
+            break;
+
+        if (!isCode(getFlags(eaNext)) || !isFlow(getFlags(eaNext)))
+            break;
+
+        if (get_first_fcref_to(eaNext) != BADADDR)
+        {
+            contribute(eaNext, &state);
+            break;
+        }
+    }
+
+    set_block_end(eaStart, eaNext > eaStart ? eaNext : eaStart + 1);
+
+    if (eaFunc == BADADDR)
+        return;
+
+    if (get_summary(eaFunc, &old) && old.fWrites == summary.fWrites && old.fReturns == summary.fReturns
+     && (!summary.fReturns || same_state(&old.ret, &summary.ret)))
+        return;
+
+    helper.supset(eaFunc, &summary, sizeof(summary), TAG_SUMMARY);
+    queue_callers(eaFunc);
+}
+
+// The summary of eaFunc changed, revisit the blocks that call it
+static void queue_callers(ea_t eaFunc)
+{
+    m8b_regstate state;
+    m8b_insn insn;
+    ea_t eaFrom, eaBlock;
+
+    for (eaFrom = get_first_fcref_to(eaFunc); eaFrom != BADADDR; eaFrom = get_next_fcref_to(eaFunc, eaFrom))
+    {
+        if (!decode_rom(eaFrom, &insn) || insn.itype != M8B_CALL)
+            continue;
+
+        eaBlock = find_block_start(eaFrom);
+        if (get_block_entry(eaBlock, &state))
+            qvWork.push_back(eaBlock);
+    }
+}
+
+static bool same_state(const m8b_regstate* p1, const m8b_regstate* p2)
+{
+    if (p1->flags != p2->flags) return false;
+    if ((p1->flags & (M8B_RS_A | M8B_RS_APORT)) && p1->a != p2->a) return false;
+    if ((p1->flags & M8B_RS_APORT) && p1->eaRead != p2->eaRead) return false;
+    if ((p1->flags & M8B_RS_X) && p1->x != p2->x) return false;
+    if ((p1->flags & M8B_RS_DSP) && p1->dsp != p2->dsp) return false;
+    if ((p1->flags & M8B_RS_PSP) && p1->psp != p2->psp) return false;
+    return true;
+}
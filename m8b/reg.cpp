@@ -1,4 +1,4 @@
-#include "m8b.hpp"
+#include "dec.hpp"
 #include <entry.hpp>
 #include <srarea.hpp>
 #include "idp.hpp"
@@ -48,7 +48,105 @@ cfg_entry;
 static qvector<cfg_entry> qvEntries;
 static qvector<cfg_entry> qvAliases;
 
+// Compiled device database: a per device image of what parse_config_file()
+// reads from m8b.cfg, kept in the user IDA directory. m8b.cfg stays the
+// source of truth; the image records the size and hash of the cfg it was
+// compiled from and is rebuilt when they no longer match. Strings live in
+// one table at the end and are referenced by offset, so loading is a single
+// read plus pointer fixups.
+#define DEVDB_MAGIC    0x42443843  // "C8DB"
+#define DEVDB_VERSION  1
+#define DEVDB_NOSTR    0xFFFFFFFF
+#define DEVDB_BITS     (sizeof(ioport_bits_t)/sizeof(ioport_bit_t))
+
+typedef struct devdb_header_t
+{
+    uint32 dwMagic;
+    uint32 dwVersion;
+    uint32 cbCfg;           // size and hash of the m8b.cfg compiled from
+    uint32 dwCfgHash;
+    uint32 nBitsPerPort;
+    uint32 cbROM;
+    uint32 cbRAM;
+    uint32 nPorts;
+    uint32 nBitPorts;       // ports with bit definitions
+    uint32 nEntries;
+    uint32 nAliases;
+    uint32 cbStrings;
+}
+devdb_header;
+
+typedef struct devdb_port_t
+{
+    uint32 address;
+    uint32 name;
+    uint32 cmt;
+    uint32 bits;            // index of the first bit record or DEVDB_NOSTR
+}
+devdb_port;
+
+typedef struct devdb_bit_t
+{
+    uint32 name;
+    uint32 cmt;
+}
+devdb_bit;
+
+typedef struct devdb_entry_t
+{
+    uint32 ea;
+    uint32 name;
+    uint32 cmt;
+}
+devdb_entry;
+
+// The loaded image; pIOPorts points into qvDBPorts while fPortsFromDB is set
+static qvector<uchar> qvDeviceDB;
+static qvector<ioport_t> qvDBPorts;
+static qvector<ioport_bit_t> qvDBBits;
+static bool fPortsFromDB;
+
+enum segno_t { sROM = 0, sRAM, sIOP, sLast };
+
+static const char* rgszSegNames[] = { SEGNAME_ROM, SEGNAME_RAM, SEGNAME_IOP };
+
+// Selectors, bases and bounds of the ROM/RAM/IOP segments. Every operand goes
+// through toROM/toRAM/toIOP, so this is filled once per database instead of
+// searching the segments by name on each call.
+typedef struct seg_cache_t
+{
+    bool fValid;
+    sel_t rgSel[sLast];
+    ea_t rgBase[sLast];
+    area_t rgArea[sLast];
+}
+seg_cache;
+
+static seg_cache segCache;
+
+// Copy of the ROM segment (at most 8K) for ana() and the heuristics, taken on
+// first use after the segments changed and kept current through byte_patched
+static qvector<uint8> qvROMSnapshot;
+static ea_t eaROMSnapshot = BADADDR;    // ROM start of the copy, BADADDR when stale
+
+// Port and bit names by address. The I/O space is 0x00-0xFF and the ports
+// are 8 bits wide, so symbol lookups are plain array loads.
+static const char* rgszPortNames[0x100];
+static const char* rgszBitNames[0x100][8];
+
+// Open addressing index over the port and bit names of pIOPorts, so name
+// checks don't walk every port and bit. Rebuilt whenever the ports are read.
+static qvector<const char*> qvSymIndex;
+
+// get_portbits_sym() results per port and mask value, rendered on first use
+// and freed together with pIOPorts. szNoBits marks masks without any symbol.
+typedef char* portbits_cache[0x100];
+
+static portbits_cache* rgpBitsCache[0x100];
+static char szNoBits[] = "";
+
 static int idaapi notify(processor_t::idp_notify msgid, ...);
+static int idaapi idb_callback(void*, int code, va_list va);
 static const char* idaapi set_idp_options(const char* szKeyword, int, const void*);
 static const char* idaapi parse_area_line(const char* szLine, char* szDeviceParams, size_t cbDeviceParams);
 static const char* idaapi parse_area_line0(const char* szLine, char* szDeviceParams, size_t cbDeviceParams);
@@ -57,28 +155,135 @@ static bool parse_config_file();
 static void set_device_name(const char* szName);
 static void setup_device();
 static void create_mappings();
-static inline ea_t map_addr(ea_t ea, const char* szSegmentName);
+static void create_code(const qvector<uint16>& qveaRoots);
+static void invalidate_segs();
+static const seg_cache& get_segs();
+static segment_t* get_seg(segno_t n);
+static inline ea_t map_addr(ea_t ea, segno_t n);
+static bool take_rom_snapshot();
+static uint32 hash_name(const char* szName);
+static void index_port_syms();
+static void map_port_syms();
+static void free_port_syms();
+static bool build_portbits_sym(char szSym[MAXSTR], ea_t eaPort, size_t nMask);
+static void free_portbits_cache();
+static uint32 hash_bytes(uint32 dwHash, const void* pv, size_t cb);
+static bool hash_cfg_file(const char* szPath, uint32* pcbCfg, uint32* pdwHash);
+static bool get_device_db_path(char* szPath, size_t cbPath);
+static bool load_device_db(const char* szPath, uint32 cbCfg, uint32 dwCfgHash);
+static void save_device_db(const char* szPath, uint32 cbCfg, uint32 dwCfgHash);
+
+segment_t* segROM() { return get_seg(sROM); }
+segment_t* segRAM() { return get_seg(sRAM); }
+segment_t* segIOP() { return get_seg(sIOP); }
+ea_t toROM(ea_t ea) { return map_addr(ea, sROM); }
+ea_t toRAM(ea_t ea) { return map_addr(ea, sRAM); }
+ea_t toIOP(ea_t ea) { return map_addr(ea, sIOP); }
+
+// ROM bytes from ea to the end of the ROM (*pcbLeft of them), NULL outside it
+const uint8* get_rom_bytes(ea_t ea, size_t* pcbLeft)
+{
+    if (eaROMSnapshot == BADADDR && !take_rom_snapshot())
+        return NULL;
+    if (ea < eaROMSnapshot || ea - eaROMSnapshot >= qvROMSnapshot.size())
+        return NULL;
+
+    *pcbLeft = qvROMSnapshot.size() - (ea - eaROMSnapshot);
+    return qvROMSnapshot.begin() + (ea - eaROMSnapshot);
+}
+
+uint8 get_rom_byte(ea_t ea)
+{
+    size_t cbLeft;
+    const uint8* pb = get_rom_bytes(ea, &cbLeft);
+
+    return pb ? *pb : get_byte(ea);
+}
+
+// A byte past the copy may extend the loaded part, so that takes a new copy
+void patch_rom_snapshot(ea_t ea)
+{
+    if (eaROMSnapshot == BADADDR || ea < eaROMSnapshot)
+        return;
+    if (ea - eaROMSnapshot < qvROMSnapshot.size())
+        qvROMSnapshot[ea - eaROMSnapshot] = get_byte(ea);
+    else
+        eaROMSnapshot = BADADDR;
+}
+
+// Entry points that are code in the ROM segment (the vectors from m8b.cfg),
+// named by their address when they have no name
+void get_rom_entries(qvector<rom_entry>& qvEntries)
+{
+    segment_t* pSegment = segROM();
+    rom_entry entry;
+    uval_t nOrdinal;
+    size_t i;
+
+    qvEntries.clear();
+    if (!pSegment) return;
 
-segment_t* segROM() { return get_segm_by_name(SEGNAME_ROM); }
-segment_t* segRAM() { return get_segm_by_name(SEGNAME_RAM); }
-segment_t* segIOP() { return get_segm_by_name(SEGNAME_IOP); }
-ea_t toROM(ea_t ea) { return map_addr(ea, SEGNAME_ROM); }
-ea_t toRAM(ea_t ea) { return map_addr(ea, SEGNAME_RAM); }
-ea_t toIOP(ea_t ea) { return map_addr(ea, SEGNAME_IOP); }
+    for (i = 0; i < get_entry_qty(); ++i)
+    {
+        nOrdinal = get_entry_ordinal(i);
+        entry.ea = get_entry(nOrdinal);
+        if (!pSegment->contains(entry.ea) || !isCode(getFlags(entry.ea))) continue;
+        if (get_entry_name(nOrdinal, entry.szName, sizeof(entry.szName)) <= 0)
+            qsnprintf(entry.szName, sizeof(entry.szName), "%a", entry.ea);
+        qvEntries.push_back(entry);
+    }
+}
 
 const char* get_port_sym(ea_t eaPort)
 {
-  const ioport_t* pPort = find_ioport(pIOPorts, nIOPorts, eaPort);
+  const ioport_t* pPort;
+
+  if (eaPort < qnumber(rgszPortNames))
+      return rgszPortNames[eaPort];
+
+  pPort = find_ioport(pIOPorts, nIOPorts, eaPort);
   return pPort ? pPort->name : NULL;
 }
 
 const char* get_portbit_sym(ea_t eaPort, size_t nBit)
 {
-  const ioport_bit_t* pBit = find_ioport_bit(pIOPorts, nIOPorts, eaPort, nBit);
+  const ioport_bit_t* pBit;
+
+  if (eaPort < qnumber(rgszBitNames) && nBit < qnumber(rgszBitNames[0]))
+      return rgszBitNames[eaPort][nBit];
+
+  pBit = find_ioport_bit(pIOPorts, nIOPorts, eaPort, nBit);
   return pBit ? pBit->name : NULL;
 }
 
 bool get_portbits_sym(char szSym[MAXSTR], ea_t eaPort, size_t nMask)
+{
+    portbits_cache* pCache;
+    char** pszCached;
+
+    if (eaPort >= qnumber(rgpBitsCache) || nMask >= sizeof(portbits_cache)/sizeof(char*))
+        return build_portbits_sym(szSym, eaPort, nMask);
+
+    pCache = rgpBitsCache[eaPort];
+    if (!pCache)
+    {
+        pCache = (portbits_cache*)qcalloc(1, sizeof(portbits_cache));
+        if (!pCache) return build_portbits_sym(szSym, eaPort, nMask);
+        rgpBitsCache[eaPort] = pCache;
+    }
+
+    pszCached = &(*pCache)[nMask];
+    if (!*pszCached)
+    {
+        *pszCached = build_portbits_sym(szSym, eaPort, nMask) ? qstrdup(szSym) : szNoBits;
+        if (!*pszCached) return true;
+    }
+
+    qstrncpy(szSym, *pszCached, MAXSTR);
+    return *pszCached != szNoBits;
+}
+
+static bool build_portbits_sym(char szSym[MAXSTR], ea_t eaPort, size_t nMask)
 {
     size_t nBit;
     const char* szName;
@@ -111,36 +316,56 @@ bool get_portbits_sym(char szSym[MAXSTR], ea_t eaPort, size_t nMask)
 
 bool is_port_sym(const char* szName)
 {
-    size_t i, j;
-    const ioport_t* pPort;
-    const ioport_bit_t* pBit;
+    size_t nMask, i;
 
-    for (i = 0; i < nIOPorts; ++i)
-    {
-        pPort = pIOPorts + i;
+    if (qvSymIndex.empty())
+        return false;
 
-        if (!qstrcmp(pPort->name, szName))
+    nMask = qvSymIndex.size() - 1;
+    for (i = hash_name(szName) & nMask; qvSymIndex[i]; i = (i + 1) & nMask)
+    {
+        if (!qstrcmp(qvSymIndex[i], szName))
             return true;
-
-        if (pPort->bits)
-        {
-            for (j = 0; j < sizeof(ioport_bits_t)/sizeof(ioport_bit_t); ++j)
-            {
-                pBit = (*pPort->bits) + j;
-
-                if (pBit->name && !qstrcmp(pBit->name, szName))
-                    return true;
-            }
-        }
     }
 
     return false;
 }
 
+// Patched ROM bytes go into the snapshot, and the classification behind
+// is_sane_insn() is redone. Patches and operand type changes also drop the
+// rendered operands.
+static int idaapi idb_callback(void*, int code, va_list va)
+{
+    switch (code)
+    {
+    case idb_event::byte_patched:
+        patch_rom_snapshot(va_arg(va, ea_t));
+        invalidate_rom_class();
+        invalidate_out_cache();
+        break;
+    case idb_event::op_type_changed:
+        invalidate_out_cache();
+        break;
+    // Bases and the ROM snapshot follow the segments
+    case idb_event::segm_added:
+    case idb_event::segm_deleted:
+    case idb_event::segm_start_changed:
+    case idb_event::segm_end_changed:
+    case idb_event::segm_moved:
+        invalidate_segs();
+        invalidate_regstates();
+        invalidate_rom_class();
+        invalidate_out_cache();
+        break;
+    }
+    return 0;
+}
+
 static int idaapi notify(processor_t::idp_notify msgid, ...)
 {
     int code;
     segment_t* pSegment;
+    ea_t ea;
     va_list va;
     va_start(va, msgid);
 
@@ -151,10 +376,23 @@ static int idaapi notify(processor_t::idp_notify msgid, ...)
     {
     case processor_t::init:
         helper.create("$ m8b");
+        invalidate_segs();
+        invalidate_regstates();
+        invalidate_rom_class();
+        invalidate_out_cache();
+        hook_to_notification_point(HT_IDB, idb_callback, NULL);
+#ifdef _DEBUG
+        if (!check_opcodes())
+            warning("The M8B opcode table does not match the instruction features");
+#endif
         break;
 
     case processor_t::term:
-        free_ioports(pIOPorts, nIOPorts);
+        unhook_from_notification_point(HT_IDB, idb_callback, NULL);
+        del_wcet_menu();
+        del_stack_menu();
+        del_sig_menu();
+        free_port_syms();
         break;
 
     case processor_t::newfile:
@@ -164,13 +402,72 @@ static int idaapi notify(processor_t::idp_notify msgid, ...)
             set_segm_name(pSegment, SEGNAME_ROM);
             helper.altset(-1, pSegment->startEA);
         }
+        invalidate_segs();
+        invalidate_regstates();
+        invalidate_rom_class();
+        invalidate_out_cache();
+        reset_propagation();
+        reset_ram_names();
         setup_device();
         create_mappings();
+        add_wcet_menu();
+        add_stack_menu();
+        add_sig_menu();
         break;
 
     case processor_t::oldfile:
+        invalidate_segs();
+        invalidate_regstates();
+        invalidate_rom_class();
+        invalidate_out_cache();
+        reset_propagation();
+        reset_ram_names();
         if (helper.supval(-1, szDevice, sizeof(szDevice)) > 0 )
             set_device_name(szDevice);
+        get_segs();
+        add_wcet_menu();
+        add_stack_menu();
+        add_sig_menu();
+        break;
+
+    case processor_t::newseg:
+    case processor_t::move_segm:
+        invalidate_segs();
+        invalidate_regstates();
+        invalidate_rom_class();
+        invalidate_out_cache();
+        break;
+
+    case processor_t::closebase:
+        invalidate_segs();
+        invalidate_regstates();
+        invalidate_rom_class();
+        invalidate_out_cache();
+        reset_propagation();
+        reset_ram_names();
+        reset_signatures();
+        del_wcet_menu();
+        del_stack_menu();
+        del_sig_menu();
+        break;
+
+    case processor_t::create_switch_xrefs:
+        ea = va_arg(va, ea_t);
+        add_switch_xrefs(ea, va_arg(va, const switch_info_ex_t*));
+        return 2;
+
+    case processor_t::auto_empty:
+        propagate();
+        name_ram_refs();
+        apply_signatures();
+        invalidate_out_cache();
+        break;
+
+    case processor_t::renamed:
+    case processor_t::add_func:
+    case processor_t::del_func:
+    case processor_t::undefine:
+        invalidate_out_cache();
         break;
 
     case processor_t::is_sane_insn:
@@ -186,6 +483,7 @@ static const char* idaapi set_idp_options(const char* szKeyword, int, const void
 {
     if (szKeyword) return IDPOPT_BADKEY;
     setup_device();
+    invalidate_out_cache();
     return IDPOPT_OK;
 }
 
@@ -255,7 +553,9 @@ static const char *idaapi parse_callback(const ioport_t* , size_t, const char* s
 
 static bool parse_config_file()
 {
-    char szPath[QMAXPATH];
+    char szPath[QMAXPATH], szDBPath[QMAXPATH];
+    uint32 cbCfg, dwCfgHash;
+    bool fDB;
 
     if (!qstrcmp(szDevice, NONEPROC))
         return true;
@@ -268,10 +568,21 @@ static bool parse_config_file()
 
     szDeviceParams[0] = '\0';
 
-    free_ioports(pIOPorts, nIOPorts);
+    free_port_syms();
     qvEntries.clear();
     qvAliases.clear();
-    pIOPorts = read_ioports(&nIOPorts, szPath, szDevice, sizeof(szDevice), parse_callback);
+
+    // The default device is only known after read_ioports()
+    fDB = szDevice[0] && hash_cfg_file(szPath, &cbCfg, &dwCfgHash) && get_device_db_path(szDBPath, sizeof(szDBPath));
+
+    if (!fDB || !load_device_db(szDBPath, cbCfg, dwCfgHash))
+    {
+        pIOPorts = read_ioports(&nIOPorts, szPath, szDevice, sizeof(szDevice), parse_callback);
+        if (fDB) save_device_db(szDBPath, cbCfg, dwCfgHash);
+    }
+
+    map_port_syms();
+    index_port_syms();
 
     return true;
 }
@@ -311,6 +622,7 @@ static void setup_device()
 
         set_segm_end(pSegment->startEA, pSegment->startEA + cbROM, SEGMOD_KILL);
         set_segm_name(pSegment, SEGNAME_ROM);
+        invalidate_segs();
     }
 
     pSegment = segRAM();
@@ -326,6 +638,7 @@ static void setup_device()
         ea = pSegment->startEA;
         set_default_dataseg(pSegment->sel);
         set_segm_end(ea, ea + cbRAM, SEGMOD_KILL);
+        invalidate_segs();
     }
 
     pSegment = segIOP();
@@ -340,6 +653,7 @@ static void setup_device()
     {
         ea = pSegment->startEA;
         set_segm_end(ea, ea + 0x100, SEGMOD_KILL);
+        invalidate_segs();
     }
 }
 
@@ -347,6 +661,7 @@ static void create_mappings()
 {
     char szComment[MAXSTR];
     segment_t* pSegment;
+    qvector<uint16> qveaRoots;
     ioport_t* pPort;
     ea_t ea;
     uint8 opcode;
@@ -364,15 +679,17 @@ static void create_mappings()
             {
                 fJmp1 = true;
 
-                opcode = get_byte(ea);
+                opcode = get_rom_byte(ea);
                 fJmp0 = opcode >= 0x80 && opcode <= 0x8F;
                 if (ea >= get_segm_base(pSegment) + 2)
                 {
-                    opcode = get_byte(ea - 2);
+                    opcode = get_rom_byte(ea - 2);
                     fJmp1 = opcode >= 0x80 && opcode <= 0x8F;
                 }
 
                 if (fJmp0) create_insn(ea);
+                if ((fJmp0 || fJmp1) && ea >= pSegment->startEA)
+                    qveaRoots.push_back((uint16)(ea - pSegment->startEA));
 
                 if (fJmp1)
                     helper.altset(ea, 1);
@@ -390,6 +707,9 @@ static void create_mappings()
         }
     }
 
+    if (!qveaRoots.empty())
+        create_code(qveaRoots);
+
     pSegment = segRAM();
     if (pSegment)
     {
@@ -424,12 +744,516 @@ static void create_mappings()
     }
 }
 
-static inline ea_t map_addr(ea_t ea, const char* szSegmentName)
+// Follow the code from the vectors in one recursive descent over the ROM
+// snapshot (m8b_descend) and create what it finds in address order, instead
+// of leaving the auto queue to discover it one address at a time. emu() still
+// runs for every instruction, so tables and names come out as before.
+static void create_code(const qvector<uint16>& qveaRoots)
+{
+    qvector<uint8> qvbFlags;
+    qvector<uint16> qveaWork;
+    m8b_decoder decoder;
+    segment_t* pSegment;
+    const uint8* pbROM;
+    size_t cbROM, off, nInsns = 0, nFuncs = 0;
+
+    pSegment = segROM();
+    if (!pSegment) return;
+    pbROM = get_rom_bytes(pSegment->startEA, &cbROM);
+    if (!pbROM) return;
+
+    show_wait_box("Following the code from the vectors");
+    m8b_init(&decoder, pbROM, cbROM);
+    qvbFlags.resize(cbROM);
+    qveaWork.resize(cbROM);
+    m8b_descend(&decoder, qveaRoots.begin(), qveaRoots.size(), qvbFlags.begin(), qveaWork.begin(), NULL, NULL);
+
+    // Which subroutines return, before emu() sees the first CALL
+    replace_wait_box("Summarizing subroutines");
+    store_call_effects(&decoder, qvbFlags.begin());
+
+    for (off = 0; off < cbROM; ++off)
+    {
+        if ((off & 0xFF) == 0)
+        {
+            if (wasBreak()) break;
+            replace_wait_box("Creating instructions %u%%", (uint32)(off * 100 / cbROM));
+        }
+
+        if ((qvbFlags[off] & M8B_DF_CODE) && create_insn(pSegment->startEA + off))
+            ++nInsns;
+    }
+
+    // Functions once their code is there, so their bounds are found right away
+    for (off = 0; off < cbROM && !wasBreak(); ++off)
+    {
+        if ((qvbFlags[off] & (M8B_DF_CODE | M8B_DF_CALL)) == (M8B_DF_CODE | M8B_DF_CALL) && add_func(pSegment->startEA + off, BADADDR))
+            ++nFuncs;
+    }
+
+    hide_wait_box();
+    msg("%u instructions and %u functions found from %u vectors\n", (uint32)nInsns, (uint32)nFuncs, (uint32)qveaRoots.size());
+}
+
+static void invalidate_segs()
+{
+    segCache.fValid = false;
+    eaROMSnapshot = BADADDR;
+}
+
+// The segment may run past the loaded image (setup_device() grows it to the
+// part's ROM). The copy ends with the last loaded byte, so past it ana() and
+// the heuristics go to the database, and holes read as get_byte() has them.
+static bool take_rom_snapshot()
+{
+    segment_t* pSegment = segROM();
+    size_t off, cbLoaded = 0;
+
+    if (!pSegment) return false;
+
+    qvROMSnapshot.resize(pSegment->endEA - pSegment->startEA);
+    if (!get_many_bytes(pSegment->startEA, qvROMSnapshot.begin(), qvROMSnapshot.size()))
+    {
+        for (off = 0; off < qvROMSnapshot.size(); ++off)
+        {
+            qvROMSnapshot[off] = get_byte(pSegment->startEA + off);
+            if (isLoaded(pSegment->startEA + off)) cbLoaded = off + 1;
+        }
+        qvROMSnapshot.resize(cbLoaded);
+    }
+
+    eaROMSnapshot = pSegment->startEA;
+    return true;
+}
+
+static const seg_cache& get_segs()
+{
+    segment_t* pSegment;
+    size_t i;
+
+    if (segCache.fValid)
+        return segCache;
+
+    for (i = 0; i < sLast; ++i)
+    {
+        pSegment = get_segm_by_name(rgszSegNames[i]);
+        if (pSegment)
+        {
+            segCache.rgSel[i] = pSegment->sel;
+            segCache.rgBase[i] = get_segm_base(pSegment);
+            segCache.rgArea[i].startEA = pSegment->startEA;
+            segCache.rgArea[i].endEA = pSegment->endEA;
+        }
+        else
+        {
+            segCache.rgSel[i] = BADSEL;
+            segCache.rgBase[i] = BADADDR;
+            segCache.rgArea[i].startEA = segCache.rgArea[i].endEA = BADADDR;
+        }
+    }
+
+    segCache.fValid = true;
+    return segCache;
+}
+
+static segment_t* get_seg(segno_t n)
+{
+    const seg_cache& segs = get_segs();
+    if (segs.rgSel[n] == BADSEL) return NULL;
+    return getseg(segs.rgArea[n].startEA);
+}
+
+static inline ea_t map_addr(ea_t ea, segno_t n)
+{
+    const seg_cache& segs = get_segs();
+    if (segs.rgSel[n] == BADSEL) return BADADDR;
+    return segs.rgBase[n] + ea;
+}
+
+// FNV-1a
+static uint32 hash_name(const char* szName)
+{
+    uint32 dwHash = 2166136261u;
+
+    while (*szName)
+        dwHash = (dwHash ^ (uchar)*szName++) * 16777619u;
+
+    return dwHash;
+}
+
+static void index_port_syms()
+{
+    const char* rgszNames[1 + sizeof(ioport_bits_t)/sizeof(ioport_bit_t)];
+    const ioport_t* pPort;
+    size_t cSyms, cSlots, nMask, i, j, k, n;
+
+    qvSymIndex.clear();
+
+    for (i = 0, cSyms = 0; i < nIOPorts; ++i)
+        cSyms += 1 + (pIOPorts[i].bits ? sizeof(ioport_bits_t)/sizeof(ioport_bit_t) : 0);
+
+    if (!cSyms)
+        return;
+
+    // Keep the load factor at or below 1/2
+    for (cSlots = 16; cSlots < 2 * cSyms; cSlots <<= 1);
+    qvSymIndex.resize(cSlots, NULL);
+    nMask = cSlots - 1;
+
+    for (i = 0; i < nIOPorts; ++i)
+    {
+        pPort = pIOPorts + i;
+
+        n = 0;
+        rgszNames[n++] = pPort->name;
+        if (pPort->bits)
+        {
+            for (j = 0; j < sizeof(ioport_bits_t)/sizeof(ioport_bit_t); ++j)
+                rgszNames[n++] = (*pPort->bits)[j].name;
+        }
+
+        for (j = 0; j < n; ++j)
+        {
+            if (!rgszNames[j])
+                continue;
+
+            for (k = hash_name(rgszNames[j]) & nMask; qvSymIndex[k]; k = (k + 1) & nMask)
+            {
+                if (!qstrcmp(qvSymIndex[k], rgszNames[j]))
+                    break;
+            }
+
+            qvSymIndex[k] = rgszNames[j];
+        }
+    }
+}
+
+static void map_port_syms()
+{
+    const ioport_t* pPort;
+    size_t i, j;
+
+    memset(rgszPortNames, 0, sizeof(rgszPortNames));
+    memset(rgszBitNames, 0, sizeof(rgszBitNames));
+
+    // Same precedence as find_ioport: the first definition of an address wins
+    for (i = nIOPorts; i-- > 0; )
+    {
+        pPort = pIOPorts + i;
+        if (pPort->address >= qnumber(rgszPortNames))
+            continue;
+
+        rgszPortNames[pPort->address] = pPort->name;
+        for (j = 0; j < qnumber(rgszBitNames[0]); ++j)
+            rgszBitNames[pPort->address][j] = pPort->bits ? (*pPort->bits)[j].name : NULL;
+    }
+}
+
+// Everything that points into pIOPorts goes before the ports themselves
+static void free_port_syms()
+{
+    memset(rgszPortNames, 0, sizeof(rgszPortNames));
+    memset(rgszBitNames, 0, sizeof(rgszBitNames));
+    qvSymIndex.clear();
+    free_portbits_cache();
+
+    if (fPortsFromDB)
+    {
+        qvDBPorts.clear();
+        qvDBBits.clear();
+        qvDeviceDB.clear();
+        fPortsFromDB = false;
+    }
+    else
+        free_ioports(pIOPorts, nIOPorts);
+
+    pIOPorts = NULL;
+    nIOPorts = 0;
+}
+
+static void free_portbits_cache()
+{
+    size_t i, j;
+
+    for (i = 0; i < qnumber(rgpBitsCache); ++i)
+    {
+        if (!rgpBitsCache[i])
+            continue;
+
+        for (j = 0; j < qnumber(*rgpBitsCache[i]); ++j)
+        {
+            if ((*rgpBitsCache[i])[j] != szNoBits)
+                qfree((*rgpBitsCache[i])[j]);
+        }
+
+        qfree(rgpBitsCache[i]);
+        rgpBitsCache[i] = NULL;
+    }
+}
+
+//-----------------------------------------------------------------------
+//      Compiled device database
+//-----------------------------------------------------------------------
+static uint32 hash_bytes(uint32 dwHash, const void* pv, size_t cb)
+{
+    const uchar* pb = (const uchar*)pv;
+
+    while (cb--)
+        dwHash = (dwHash ^ *pb++) * 16777619u;
+
+    return dwHash;
+}
+
+static bool hash_cfg_file(const char* szPath, uint32* pcbCfg, uint32* pdwHash)
 {
-    if (!szSegmentName) return BADADDR;
-    segment_t* pSegment = get_segm_by_name(szSegmentName);
-    if (!pSegment) return BADADDR;
-    return toEA(pSegment->sel, ea);
+    uchar rgbBuffer[0x1000];
+    ssize_t cb;
+    FILE* fp;
+
+    fp = qfopen(szPath, "rb");
+    if (!fp) return false;
+
+    *pcbCfg = 0;
+    *pdwHash = 2166136261u;
+
+    while ((cb = qfread(fp, rgbBuffer, sizeof(rgbBuffer))) > 0)
+    {
+        *pcbCfg += (uint32)cb;
+        *pdwHash = hash_bytes(*pdwHash, rgbBuffer, cb);
+    }
+
+    qfclose(fp);
+    return cb == 0;
+}
+
+static bool get_device_db_path(char* szPath, size_t cbPath)
+{
+    char szFile[QMAXPATH];
+    char* pch;
+
+    qsnprintf(szFile, sizeof(szFile), "m8b_%s.cdb", szDevice);
+    for (pch = szFile; *pch; ++pch)
+    {
+        if (!isalnum((uchar)*pch) && *pch != '.' && *pch != '_') *pch = '_';
+    }
+
+    return qmakepath(szPath, cbPath, get_user_idadir(), szFile, NULL) != NULL;
+}
+
+// Offset into the string table, NULL for DEVDB_NOSTR
+static char* devdb_string(char* pchStrings, uint32 cbStrings, uint32 off, bool* pfOk)
+{
+    if (off == DEVDB_NOSTR) return NULL;
+    if (off >= cbStrings) { *pfOk = false; return NULL; }
+    return pchStrings + off;
+}
+
+static bool load_device_db(const char* szPath, uint32 cbCfg, uint32 dwCfgHash)
+{
+    const devdb_header* pHeader;
+    const devdb_port* pPorts;
+    const devdb_bit* pBits;
+    const devdb_entry* pEntries;
+    cfg_entry entry;
+    char* pchStrings;
+    ioport_t* pPort;
+    const char* szName;
+    const char* szComment;
+    size_t cbFile, i;
+    uint64 cbExpected;
+    bool fOk = true;
+    FILE* fp;
+
+    fp = qfopen(szPath, "rb");
+    if (!fp) return false;
+
+    qfseek(fp, 0, SEEK_END);
+    cbFile = qftell(fp);
+    qfseek(fp, 0, SEEK_SET);
+
+    if (cbFile < sizeof(devdb_header))
+    {
+        qfclose(fp);
+        return false;
+    }
+
+    qvDeviceDB.resize(cbFile);
+    fOk = qfread(fp, qvDeviceDB.begin(), cbFile) == (ssize_t)cbFile;
+    qfclose(fp);
+
+    pHeader = (const devdb_header*)qvDeviceDB.begin();
+    if (fOk)
+    {
+        // In 64 bits, so corrupt counts can not wrap around to the file size
+        cbExpected = sizeof(devdb_header) + (uint64)pHeader->nPorts * sizeof(devdb_port)
+                   + (uint64)pHeader->nBitPorts * DEVDB_BITS * sizeof(devdb_bit)
+                   + ((uint64)pHeader->nEntries + pHeader->nAliases) * sizeof(devdb_entry) + pHeader->cbStrings;
+
+        fOk = pHeader->dwMagic == DEVDB_MAGIC && pHeader->dwVersion == DEVDB_VERSION && pHeader->nBitsPerPort == DEVDB_BITS
+           && pHeader->cbCfg == cbCfg && pHeader->dwCfgHash == dwCfgHash && pHeader->nBitPorts <= pHeader->nPorts
+           && cbExpected == cbFile && pHeader->cbStrings && qvDeviceDB[cbFile - 1] == '\0';
+    }
+
+    if (!fOk)
+    {
+        qvDeviceDB.clear();
+        return false;
+    }
+
+    pPorts = (const devdb_port*)(pHeader + 1);
+    pBits = (const devdb_bit*)(pPorts + pHeader->nPorts);
+    pEntries = (const devdb_entry*)(pBits + pHeader->nBitPorts * DEVDB_BITS);
+    pchStrings = (char*)(pEntries + pHeader->nEntries + pHeader->nAliases);
+
+    qvDBBits.resize(pHeader->nBitPorts * DEVDB_BITS);
+    for (i = 0; i < qvDBBits.size(); ++i)
+    {
+        qvDBBits[i].name = devdb_string(pchStrings, pHeader->cbStrings, pBits[i].name, &fOk);
+        qvDBBits[i].cmt = devdb_string(pchStrings, pHeader->cbStrings, pBits[i].cmt, &fOk);
+    }
+
+    qvDBPorts.resize(pHeader->nPorts);
+    for (i = 0; i < qvDBPorts.size(); ++i)
+    {
+        pPort = &qvDBPorts[i];
+        pPort->address = pPorts[i].address;
+        pPort->name = devdb_string(pchStrings, pHeader->cbStrings, pPorts[i].name, &fOk);
+        pPort->cmt = devdb_string(pchStrings, pHeader->cbStrings, pPorts[i].cmt, &fOk);
+        pPort->userdata = NULL;
+        pPort->bits = NULL;
+
+        if (pPorts[i].bits != DEVDB_NOSTR)
+        {
+            if (pPorts[i].bits % DEVDB_BITS || pPorts[i].bits >= qvDBBits.size())
+                fOk = false;
+            else
+                pPort->bits = (ioport_bits_t*)&qvDBBits[pPorts[i].bits];
+        }
+    }
+
+    for (i = 0; i < pHeader->nEntries + pHeader->nAliases; ++i)
+    {
+        szName = devdb_string(pchStrings, pHeader->cbStrings, pEntries[i].name, &fOk);
+        szComment = devdb_string(pchStrings, pHeader->cbStrings, pEntries[i].cmt, &fOk);
+        entry.eaLocation = pEntries[i].ea;
+        entry.strName = szName ? szName : "";
+        entry.strComment = szComment ? szComment : "";
+        (i < pHeader->nEntries ? qvEntries : qvAliases).push_back(entry);
+    }
+
+    if (!fOk)
+    {
+        qvDBPorts.clear();
+        qvDBBits.clear();
+        qvDeviceDB.clear();
+        qvEntries.clear();
+        qvAliases.clear();
+        return false;
+    }
+
+    cbROM = pHeader->cbROM;
+    cbRAM = pHeader->cbRAM;
+    if (cbROM || cbRAM)
+        qsnprintf(szDeviceParams, sizeof(szDeviceParams), DEVICEPARAMS, cbROM, cbRAM);
+
+    pIOPorts = qvDBPorts.begin();
+    nIOPorts = qvDBPorts.size();
+    fPortsFromDB = true;
+
+    return true;
+}
+
+static uint32 devdb_add_string(qvector<char>& qvStrings, const char* sz)
+{
+    size_t off, cch;
+
+    if (!sz) return DEVDB_NOSTR;
+
+    off = qvStrings.size();
+    cch = qstrlen(sz) + 1;
+    qvStrings.resize(off + cch);
+    memcpy(&qvStrings[off], sz, cch);
+    return (uint32)off;
+}
+
+static void devdb_add_entries(qvector<devdb_entry>& qvOut, qvector<char>& qvStrings, const qvector<cfg_entry>& qvIn)
+{
+    devdb_entry entry;
+    size_t i;
+
+    for (i = 0; i < qvIn.size(); ++i)
+    {
+        entry.ea = (uint32)qvIn[i].eaLocation;
+        entry.name = devdb_add_string(qvStrings, qvIn[i].strName.c_str());
+        entry.cmt = devdb_add_string(qvStrings, qvIn[i].strComment.c_str());
+        qvOut.push_back(entry);
+    }
+}
+
+static void save_device_db(const char* szPath, uint32 cbCfg, uint32 dwCfgHash)
+{
+    devdb_header header;
+    qvector<devdb_port> qvPorts;
+    qvector<devdb_bit> qvBits;
+    qvector<devdb_entry> qvEntryRecs;
+    qvector<char> qvStrings;
+    devdb_port port;
+    devdb_bit bit;
+    const ioport_t* pPort;
+    size_t i, j;
+    bool fOk;
+    FILE* fp;
+
+    for (i = 0; i < nIOPorts; ++i)
+    {
+        pPort = pIOPorts + i;
+        port.address = (uint32)pPort->address;
+        port.name = devdb_add_string(qvStrings, pPort->name);
+        port.cmt = devdb_add_string(qvStrings, pPort->cmt);
+        port.bits = DEVDB_NOSTR;
+
+        if (pPort->bits)
+        {
+            port.bits = (uint32)qvBits.size();
+            for (j = 0; j < DEVDB_BITS; ++j)
+            {
+                bit.name = devdb_add_string(qvStrings, (*pPort->bits)[j].name);
+                bit.cmt = devdb_add_string(qvStrings, (*pPort->bits)[j].cmt);
+                qvBits.push_back(bit);
+            }
+        }
+
+        qvPorts.push_back(port);
+    }
+
+    devdb_add_entries(qvEntryRecs, qvStrings, qvEntries);
+    devdb_add_entries(qvEntryRecs, qvStrings, qvAliases);
+    qvStrings.push_back('\0');
+
+    header.dwMagic = DEVDB_MAGIC;
+    header.dwVersion = DEVDB_VERSION;
+    header.cbCfg = cbCfg;
+    header.dwCfgHash = dwCfgHash;
+    header.nBitsPerPort = DEVDB_BITS;
+    header.cbROM = (uint32)cbROM;
+    header.cbRAM = (uint32)cbRAM;
+    header.nPorts = (uint32)qvPorts.size();
+    header.nBitPorts = (uint32)(qvBits.size() / DEVDB_BITS);
+    header.nEntries = (uint32)qvEntries.size();
+    header.nAliases = (uint32)qvAliases.size();
+    header.cbStrings = (uint32)qvStrings.size();
+
+    fp = qfopen(szPath, "wb");
+    if (!fp) return;
+
+    fOk = qfwrite(fp, &header, sizeof(header)) == sizeof(header);
+    if (fOk && !qvPorts.empty()) fOk = qfwrite(fp, qvPorts.begin(), qvPorts.size() * sizeof(devdb_port)) == (ssize_t)(qvPorts.size() * sizeof(devdb_port));
+    if (fOk && !qvBits.empty()) fOk = qfwrite(fp, qvBits.begin(), qvBits.size() * sizeof(devdb_bit)) == (ssize_t)(qvBits.size() * sizeof(devdb_bit));
+    if (fOk && !qvEntryRecs.empty()) fOk = qfwrite(fp, qvEntryRecs.begin(), qvEntryRecs.size() * sizeof(devdb_entry)) == (ssize_t)(qvEntryRecs.size() * sizeof(devdb_entry));
+    if (fOk) fOk = qfwrite(fp, qvStrings.begin(), qvStrings.size()) == (ssize_t)qvStrings.size();
+
+    qfclose(fp);
+    if (!fOk) qunlink(szPath);
 }
 
 //-----------------------------------------------------------------------
@@ -543,7 +1367,7 @@ processor_t LPH =
                                 // normal float
                                 // normal double
                                 // long double
-    NULL,                       // int (*is_switch)(switch_info_t *si);
+    is_switch,                  // int (*is_switch)(switch_info_t *si);
     NULL,                       // long (*gen_map_file)(FILE *fp);
     NULL,                       // ea_t (*extract_address)(ea_t ea,const char *string,int x);
     NULL,                       // int (*is_sp_based)(op_t &x);
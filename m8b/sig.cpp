@@ -0,0 +1,157 @@
+#include "sig.hpp"
+#include <string.h>
+
+#define FNV_BASIS 2166136261u
+#define FNV_PRIME 16777619u
+#define MASKED    0xFF      // stands for a relocatable operand in the hash
+
+static uint32 hash_byte(uint32 dwHash, uint8 b)
+{
+    return (dwHash ^ b) * FNV_PRIME;
+}
+
+// The instructions reached from ea through flow and jumps that stay within
+// M8B_SIG_MAXCODE bytes, hashed in address order (see sig.hpp). Fails on an
+// invalid opcode and for routines under M8B_SIG_MININSNS instructions.
+bool m8b_sig_hash(const m8b_decoder* pDecoder, size_t ea, m8b_sig* pSig)
+{
+    uint8 rgbStart[M8B_SIG_MAXCODE];    // an instruction starts at this offset
+    uint16 rgoffWork[M8B_SIG_MAXCODE];
+    m8b_ref rgRefs[M8B_MAXREFS];
+    m8b_insn insn;
+    size_t off, offTo, offEnd = 0, nWork = 0, nInsns = 0, nRefs, n;
+    uint32 dwHash = FNV_BASIS;
+    uint8 code, operand;
+
+    memset(rgbStart, 0, sizeof(rgbStart));
+    rgoffWork[nWork++] = 0;
+
+    while (nWork)
+    {
+        for (off = rgoffWork[--nWork]; off < M8B_SIG_MAXCODE && !rgbStart[off]; off += insn.size)
+        {
+            if (!m8b_decode(pDecoder, ea + off, &insn))
+                return false;
+
+            rgbStart[off] = 1;
+            ++nInsns;
+            if (off + insn.size > offEnd) offEnd = off + insn.size;
+
+            nRefs = m8b_xrefs(&insn, rgRefs);
+            for (n = 0; n < nRefs; ++n)
+            {
+                if (rgRefs[n].type != rt_jump || rgRefs[n].to < ea) continue;
+                offTo = rgRefs[n].to - ea;
+                if (offTo < M8B_SIG_MAXCODE && !rgbStart[offTo])
+                    rgoffWork[nWork++] = (uint16)offTo;
+            }
+
+            if (rgInstructions[insn.itype].feature & CF_STOP) break;
+        }
+    }
+
+    if (nInsns < M8B_SIG_MININSNS)
+        return false;
+
+    for (off = 0; off < M8B_SIG_MAXCODE; ++off)
+    {
+        if (!rgbStart[off]) continue;
+        m8b_decode(pDecoder, ea + off, &insn);
+
+        // Near operands keep their high address bits in the opcode, so those
+        // are hashed by instruction type
+        nRefs = m8b_xrefs(&insn, rgRefs);
+        code = insn.code;
+        operand = insn.value;
+        for (n = 0; n < nRefs; ++n)
+        {
+            switch (rgRefs[n].type)
+            {
+            case rt_jump:
+                offTo = rgRefs[n].to - ea;
+                code = insn.itype;
+                operand = rgRefs[n].to >= ea && offTo < M8B_SIG_MAXCODE ? (uint8)offTo : MASKED;
+                break;
+            case rt_call:
+            case rt_table:
+                code = insn.itype;
+                operand = MASKED;
+                break;
+            case rt_ram:
+                operand = MASKED;
+                break;
+            }
+        }
+
+        dwHash = hash_byte(dwHash, (uint8)off);
+        dwHash = hash_byte(dwHash, code);
+        if (insn.size > 1)
+            dwHash = hash_byte(dwHash, operand);
+    }
+
+    pSig->dwHash = dwHash;
+    pSig->cbCode = (uint16)offEnd;
+    pSig->nInsns = (uint16)nInsns;
+    pSig->offName = 0;
+    return true;
+}
+
+bool m8b_sig_less(const m8b_sig& a, const m8b_sig& b)
+{
+    if (a.dwHash != b.dwHash) return a.dwHash < b.dwHash;
+    if (a.cbCode != b.cbCode) return a.cbCode < b.cbCode;
+    return a.nInsns < b.nInsns;
+}
+
+// Check an index file read into memory and point pIndex into it
+bool m8b_sig_open(m8b_sig_index* pIndex, const void* pvFile, size_t cbFile)
+{
+    const m8b_sig_header* pHeader = (const m8b_sig_header*)pvFile;
+    uint64 cbExpected;
+    size_t i;
+
+    if (cbFile < sizeof(m8b_sig_header)) return false;
+    if (pHeader->dwMagic != M8B_SIG_MAGIC || pHeader->dwVersion != M8B_SIG_VERSION) return false;
+    if (pHeader->nSigs > M8B_SIG_MAXSIGS) return false;
+
+    // In 64 bits, so corrupt counts can not wrap around to the file size
+    cbExpected = sizeof(m8b_sig_header) + (uint64)pHeader->nSigs * sizeof(m8b_sig) + pHeader->cbNames;
+    if (cbExpected != cbFile) return false;
+    // An index without routines has no names either
+    if (pHeader->nSigs && !pHeader->cbNames) return false;
+
+    pIndex->rgSigs = (const m8b_sig*)(pHeader + 1);
+    pIndex->nSigs = pHeader->nSigs;
+    pIndex->pchNames = (const char*)(pIndex->rgSigs + pIndex->nSigs);
+    pIndex->cbNames = pHeader->cbNames;
+    if (pIndex->cbNames && pIndex->pchNames[pIndex->cbNames - 1] != '\0') return false;
+
+    for (i = 0; i < pIndex->nSigs; ++i)
+    {
+        if (pIndex->rgSigs[i].offName >= pIndex->cbNames) return false;
+        if (i && m8b_sig_less(pIndex->rgSigs[i], pIndex->rgSigs[i - 1])) return false;
+    }
+
+    return true;
+}
+
+// Name of the known routine at ea, NULL if there is none
+const char* m8b_sig_match(const m8b_sig_index* pIndex, const m8b_decoder* pDecoder, size_t ea)
+{
+    m8b_sig sig;
+    size_t nLow = 0, nHigh = pIndex->nSigs, nMid;
+
+    if (!pIndex->nSigs || !m8b_sig_hash(pDecoder, ea, &sig))
+        return NULL;
+
+    while (nLow < nHigh)
+    {
+        nMid = (nLow + nHigh) / 2;
+        if (m8b_sig_less(pIndex->rgSigs[nMid], sig)) nLow = nMid + 1;
+        else nHigh = nMid;
+    }
+
+    if (nLow == pIndex->nSigs || m8b_sig_less(sig, pIndex->rgSigs[nLow]))
+        return NULL;
+    return pIndex->pchNames + pIndex->rgSigs[nLow].offName;
+}
@@ -0,0 +1,57 @@
+#ifndef SIG_HPP_INCLUDED
+#define SIG_HPP_INCLUDED
+
+// Function fingerprints for naming known library routines (the Cypress USB
+// framework and the like). A function is hashed over the code reachable from
+// its entry without following calls, with the relocatable operands masked:
+// jump and call targets outside the function, INDEX tables and RAM addresses.
+// Jumps inside it count as offsets from the entry, so the same routine matches
+// wherever it was linked.
+//
+// Index file: m8b_sig_header, nSigs m8b_sig sorted by hash and size, then the
+// NUL terminated names (cbNames bytes).
+
+#include "dec.hpp"
+
+#define M8B_SIG_MAGIC    0x4753384Du    // "M8SG"
+#define M8B_SIG_VERSION  1
+#define M8B_SIG_MAXCODE  0x100          // bytes from the entry a function may span
+#define M8B_SIG_MININSNS 4              // shorter routines are too common to name
+#define M8B_SIG_MAXSIGS  0x100000       // more routines than any index holds
+
+typedef struct m8b_sig_header_t
+{
+    uint32 dwMagic;
+    uint32 dwVersion;
+    uint32 nSigs;
+    uint32 cbNames;
+}
+m8b_sig_header;
+
+typedef struct m8b_sig_t
+{
+    uint32 dwHash;
+    uint16 cbCode;      // bytes from the entry to the end of the last instruction
+    uint16 nInsns;
+    uint32 offName;     // into the names
+}
+m8b_sig;
+
+CASSERT(sizeof(m8b_sig) == 12);
+
+// A loaded index. Points into the caller's copy of the file.
+typedef struct m8b_sig_index_t
+{
+    const m8b_sig* rgSigs;
+    size_t nSigs;
+    const char* pchNames;
+    size_t cbNames;
+}
+m8b_sig_index;
+
+bool m8b_sig_hash(const m8b_decoder* pDecoder, size_t ea, m8b_sig* pSig);
+bool m8b_sig_less(const m8b_sig& a, const m8b_sig& b);
+bool m8b_sig_open(m8b_sig_index* pIndex, const void* pvFile, size_t cbFile);
+const char* m8b_sig_match(const m8b_sig_index* pIndex, const m8b_decoder* pDecoder, size_t ea);
+
+#endif
@@ -0,0 +1,404 @@
+#include "sim.hpp"
+#include <string.h>
+
+// Semantics follow the CYASM user's guide (B CPU): RET leaves the flags alone,
+// CALL and interrupts push PC with CF in bit 7 and ZF in bit 6 of the high
+// byte, PUSH pre-decrements DSP, and sequential code wraps inside its 256 byte
+// page unless XPAGE moves on to the next one.
+
+#define INTCYCLES 10    // interrupt acknowledge, a CALL into the vector
+
+#if defined(__GNUC__) && !defined(M8B_SIM_SWITCH)
+#define M8B_SIM_THREADED
+#endif
+
+static uint8 simop_kind(const opcode_desc* pOpcode);
+
+void m8b_sim_predecode(const uint8* pbROM, size_t cbROM, m8b_simop* rgOps)
+{
+    m8b_insn insn;
+    m8b_simop* pOp;
+    size_t ea, eaNext;
+
+    for (ea = 0; ea <= cbROM; ++ea)
+    {
+        pOp = rgOps + ea;
+        memset(pOp, 0, sizeof(*pOp));
+        pOp->addr = (uint16)cbROM;
+        pOp->next = (uint16)cbROM;
+
+        if (ea == cbROM || !m8b_decode_bytes(ea, pbROM + ea, cbROM - ea, &insn))
+            continue;
+
+        pOp->kind = simop_kind(rgOpcodes + insn.code);
+        pOp->value = insn.value;
+        pOp->cycles = rgOpcodes[insn.code].cycles;
+        if (insn.addr < cbROM || insn.itype == M8B_JACC || insn.itype == M8B_INDEX)
+            pOp->addr = insn.addr;
+
+        if (insn.itype == M8B_XPAGE)
+            eaNext = ea + 1;
+        else
+            eaNext = (ea & ~(size_t)0xFF) | ((ea + insn.size) & 0xFF);
+        if (eaNext < cbROM)
+            pOp->next = (uint16)eaNext;
+    }
+}
+
+// RAM addresses wrap with a mask, so cbRAM has to be a power of two up to 256
+bool m8b_sim_init(m8b_sim* pSim, const uint8* pbROM, size_t cbROM, size_t cbRAM, const m8b_simop* rgOps)
+{
+    if (!cbRAM || cbRAM > sizeof(pSim->rgbRAM) || (cbRAM & (cbRAM - 1)))
+        return false;
+
+    memset(pSim, 0, sizeof(*pSim));
+    pSim->pbROM = pbROM;
+    pSim->cbROM = cbROM;
+    pSim->cbRAM = cbRAM;
+    pSim->rgOps = rgOps;
+    m8b_sim_reset(pSim);
+    return true;
+}
+
+// Registers and both stack pointers are cleared, RAM and ports keep their contents
+void m8b_sim_reset(m8b_sim* pSim)
+{
+    pSim->pc = 0;
+    pSim->a = pSim->x = 0;
+    pSim->dsp = pSim->psp = 0;
+    pSim->cf = pSim->zf = 0;
+    pSim->ie = 0;
+    pSim->fHalted = 0;
+}
+
+// Acknowledge an interrupt: push PC and flags like a CALL and continue at the
+// vector. Refused while interrupts are disabled or the core is halted.
+bool m8b_sim_interrupt(m8b_sim* pSim, uint16 eaVector)
+{
+    uint8 mask = (uint8)(pSim->cbRAM - 1);
+
+    if (!pSim->ie || pSim->fHalted)
+        return false;
+
+    pSim->rgbRAM[pSim->psp++ & mask] = (uint8)pSim->pc;
+    pSim->rgbRAM[pSim->psp++ & mask] = (uint8)((pSim->pc >> 8) | (pSim->cf << 7) | (pSim->zf << 6));
+    pSim->ie = 0;
+    pSim->pc = eaVector < pSim->cbROM ? eaVector : (uint16)pSim->cbROM;
+    pSim->qwCycles += INTCYCLES;
+    return true;
+}
+
+// Run until the cycle counter reaches qwUntil. Returns m8b_sim_stop_t; the
+// instruction that stops the core is not executed and the PC points at it.
+int m8b_sim_run(m8b_sim* pSim, uint64 qwUntil)
+{
+    const m8b_simop* rgOps = pSim->rgOps;
+    const m8b_simop* pOp;
+    const uint8* pbROM = pSim->pbROM;
+    uint8* pbRAM = pSim->rgbRAM;
+    uint64 qwCycles = pSim->qwCycles;
+    uint64 qwInsns = 0;
+    size_t cbROM = pSim->cbROM;
+    uint32 t;
+    uint16 pc = pSim->pc;
+    uint8 a = pSim->a, x = pSim->x, dsp = pSim->dsp, psp = pSim->psp;
+    uint8 cf = pSim->cf, zf = pSim->zf;
+    uint8 mask = (uint8)(pSim->cbRAM - 1);
+    uint8 v;
+    int stop = m8b_sim_budget;
+
+    if (pSim->fHalted)
+        return m8b_sim_halted;
+
+// Operands
+#define IMM             (pOp->value)
+#define MEM             pbRAM[pOp->value & mask]
+#define IDX             pbRAM[(uint8)(x + pOp->value) & mask]
+#define SETZ(r)         (zf = (r) == 0)
+#define GOTO(ea)        (pc = (ea) < cbROM ? (uint16)(ea) : (uint16)cbROM)
+
+// Callbacks see the cycle count and PC of the instruction doing the I/O
+#define SYNC()          (pSim->pc = pc, pSim->qwCycles = qwCycles)
+
+#define ALU_ADD(k)      (t = a + (k), cf = t > 0xFF, a = (uint8)t, SETZ(a))
+#define ALU_ADC(k)      (t = a + (k) + cf, cf = t > 0xFF, a = (uint8)t, SETZ(a))
+#define ALU_SUB(k)      (v = (k), cf = a < v, a -= v, SETZ(a))
+#define ALU_SBB(k)      (t = (uint32)(k) + cf, cf = a < t, a = (uint8)(a - t), SETZ(a))
+#define ALU_CMP(k)      (v = (k), cf = a < v, SETZ(a - v))
+#define ALU_LOGIC(r)    (cf = 0, SETZ(r))
+
+#ifdef M8B_SIM_THREADED
+#define M8B_SIMOP_LABEL(k) &&op_##k,
+    static const void* const rgLabels[m8b_simop_last] = { M8B_SIMOPS(M8B_SIMOP_LABEL) };
+#undef M8B_SIMOP_LABEL
+
+#define OP(k)           op_##k:
+#define DISPATCH()      do { if (qwCycles >= qwUntil) goto done; pOp = rgOps + pc; goto *rgLabels[pOp->kind]; } while (0)
+#define NEXT()          do { qwCycles += pOp->cycles; ++qwInsns; pc = pOp->next; DISPATCH(); } while (0)
+#define JUMP()          do { qwCycles += pOp->cycles; ++qwInsns; DISPATCH(); } while (0)
+
+    DISPATCH();
+#else
+#define OP(k)           case m8b_simop_##k:
+#define NEXT()          do { qwCycles += pOp->cycles; ++qwInsns; pc = pOp->next; continue; } while (0)
+#define JUMP()          do { qwCycles += pOp->cycles; ++qwInsns; continue; } while (0)
+
+    while (qwCycles < qwUntil)
+    {
+        pOp = rgOps + pc;
+        switch (pOp->kind)
+        {
+#endif
+
+    OP(BAD)     stop = m8b_sim_badop; goto done;
+    OP(HALT)    pSim->fHalted = 1; qwCycles += pOp->cycles; ++qwInsns; stop = m8b_sim_halted; goto done;
+    OP(NOP)     NEXT();
+    OP(XPAGE)   NEXT();
+    OP(DI)      pSim->ie = 0; NEXT();
+    OP(EI)      pSim->ie = 1; NEXT();
+
+    OP(ADD_I)   ALU_ADD(IMM); NEXT();
+    OP(ADD_M)   ALU_ADD(MEM); NEXT();
+    OP(ADD_X)   ALU_ADD(IDX); NEXT();
+    OP(ADC_I)   ALU_ADC(IMM); NEXT();
+    OP(ADC_M)   ALU_ADC(MEM); NEXT();
+    OP(ADC_X)   ALU_ADC(IDX); NEXT();
+    OP(SUB_I)   ALU_SUB(IMM); NEXT();
+    OP(SUB_M)   ALU_SUB(MEM); NEXT();
+    OP(SUB_X)   ALU_SUB(IDX); NEXT();
+    OP(SBB_I)   ALU_SBB(IMM); NEXT();
+    OP(SBB_M)   ALU_SBB(MEM); NEXT();
+    OP(SBB_X)   ALU_SBB(IDX); NEXT();
+    OP(OR_I)    a |= IMM; ALU_LOGIC(a); NEXT();
+    OP(OR_M)    a |= MEM; ALU_LOGIC(a); NEXT();
+    OP(OR_X)    a |= IDX; ALU_LOGIC(a); NEXT();
+    OP(AND_I)   a &= IMM; ALU_LOGIC(a); NEXT();
+    OP(AND_M)   a &= MEM; ALU_LOGIC(a); NEXT();
+    OP(AND_X)   a &= IDX; ALU_LOGIC(a); NEXT();
+    OP(XOR_I)   a ^= IMM; ALU_LOGIC(a); NEXT();
+    OP(XOR_M)   a ^= MEM; ALU_LOGIC(a); NEXT();
+    OP(XOR_X)   a ^= IDX; ALU_LOGIC(a); NEXT();
+    OP(CMP_I)   ALU_CMP(IMM); NEXT();
+    OP(CMP_M)   ALU_CMP(MEM); NEXT();
+    OP(CMP_X)   ALU_CMP(IDX); NEXT();
+    OP(OR_MA)   MEM |= a; ALU_LOGIC(MEM); NEXT();
+    OP(OR_XA)   IDX |= a; ALU_LOGIC(IDX); NEXT();
+    OP(AND_MA)  MEM &= a; ALU_LOGIC(MEM); NEXT();
+    OP(AND_XA)  IDX &= a; ALU_LOGIC(IDX); NEXT();
+    OP(XOR_MA)  MEM ^= a; ALU_LOGIC(MEM); NEXT();
+    OP(XOR_XA)  IDX ^= a; ALU_LOGIC(IDX); NEXT();
+
+    OP(MOVA_I)  a = IMM; NEXT();
+    OP(MOVA_M)  a = MEM; NEXT();
+    OP(MOVA_X)  a = IDX; NEXT();
+    OP(MOVX_I)  x = IMM; NEXT();
+    OP(MOVX_M)  x = MEM; NEXT();
+    OP(MOVA_XR) a = x; NEXT();
+    OP(MOVX_A)  x = a; NEXT();
+    OP(MOVM_A)  MEM = a; NEXT();
+    OP(MOVXM_A) IDX = a; NEXT();
+    OP(MOVPSP_A) psp = a; NEXT();
+
+    OP(INC_A)   ++a; cf = zf = a == 0; NEXT();
+    OP(INC_XR)  ++x; cf = zf = x == 0; NEXT();
+    OP(INC_M)   v = ++MEM; cf = zf = v == 0; NEXT();
+    OP(INC_X)   v = ++IDX; cf = zf = v == 0; NEXT();
+    OP(DEC_A)   cf = a == 0; --a; SETZ(a); NEXT();
+    OP(DEC_XR)  cf = x == 0; --x; SETZ(x); NEXT();
+    OP(DEC_M)   v = MEM; cf = v == 0; MEM = --v; SETZ(v); NEXT();
+    OP(DEC_X)   v = IDX; cf = v == 0; IDX = --v; SETZ(v); NEXT();
+    OP(CPL)     a = ~a; cf = 1; SETZ(a); NEXT();
+    OP(ASL)     cf = a >> 7; a <<= 1; SETZ(a); NEXT();
+    OP(ASR)     cf = a & 1; a = (uint8)((a >> 1) | (a & 0x80)); SETZ(a); NEXT();
+    OP(RLC)     v = a >> 7; a = (uint8)((a << 1) | cf); cf = v; SETZ(a); NEXT();
+    OP(RRC)     v = a & 1; a = (uint8)((a >> 1) | (cf << 7)); cf = v; SETZ(a); NEXT();
+
+    OP(IORD)
+        if (!pSim->pfnRead)
+        {
+            a = pSim->rgbIO[IMM];
+            NEXT();
+        }
+        SYNC();
+        a = pSim->pfnRead(pSim->pvContext, IMM);
+        NEXT();
+    OP(IOWR)    v = IMM; goto iowrite;
+    OP(IOWX)    v = (uint8)(x + IMM); goto iowrite;
+    OP(PUSH_A)  pbRAM[--dsp & mask] = a; NEXT();
+    OP(PUSH_X)  pbRAM[--dsp & mask] = x; NEXT();
+    OP(POP_A)   a = pbRAM[dsp++ & mask]; NEXT();
+    OP(POP_X)   x = pbRAM[dsp++ & mask]; NEXT();
+    OP(SWAP_AX) v = a; a = x; x = v; NEXT();
+    OP(SWAP_AD) v = a; a = dsp; dsp = v; NEXT();
+
+    OP(JMP)     pc = pOp->addr; JUMP();
+    OP(JZ)      pc = zf ? pOp->addr : pOp->next; JUMP();
+    OP(JNZ)     pc = zf ? pOp->next : pOp->addr; JUMP();
+    OP(JC)      pc = cf ? pOp->addr : pOp->next; JUMP();
+    OP(JNC)     pc = cf ? pOp->next : pOp->addr; JUMP();
+    OP(JACC)    t = pOp->addr + a; cf = (t ^ pOp->addr) > 0xFF; zf = (t & 0xFF) == 0; GOTO(t); JUMP();
+    OP(INDEX)
+        // The core also scribbles over RAM[PSP] here, which is not modelled
+        t = pOp->addr + a; cf = (t ^ pOp->addr) > 0xFF; zf = (t & 0xFF) == 0;
+        a = t < cbROM ? pbROM[t] : 0xFF;
+        NEXT();
+    OP(CALL)
+        pbRAM[psp++ & mask] = (uint8)pOp->next;
+        pbRAM[psp++ & mask] = (uint8)((pOp->next >> 8) | (cf << 7) | (zf << 6));
+        pc = pOp->addr;
+        JUMP();
+    OP(RET)
+        psp -= 2;
+        t = pbRAM[psp & mask] | ((pbRAM[(psp + 1) & mask] & 0x3F) << 8);
+        GOTO(t);
+        JUMP();
+    OP(RETI)
+        pSim->ie = 1;
+    reti:
+        psp -= 2;
+        v = pbRAM[(psp + 1) & mask];
+        t = pbRAM[psp & mask] | ((v & 0x3F) << 8);
+        cf = v >> 7;
+        zf = (v >> 6) & 1;
+        GOTO(t);
+        JUMP();
+    OP(IPRET)
+        SYNC();
+        if (pSim->pfnWrite) pSim->pfnWrite(pSim->pvContext, IMM, a);
+        pSim->rgbIO[IMM] = a;
+        a = pbRAM[dsp++ & mask];
+        pSim->ie = 1;
+        goto reti;
+
+    iowrite:
+        SYNC();
+        if (pSim->pfnWrite) pSim->pfnWrite(pSim->pvContext, v, a);
+        pSim->rgbIO[v] = a;
+        NEXT();
+
+#ifndef M8B_SIM_THREADED
+        }
+    }
+#endif
+
+done:
+    pSim->pc = pc;
+    pSim->a = a;
+    pSim->x = x;
+    pSim->dsp = dsp;
+    pSim->psp = psp;
+    pSim->cf = cf;
+    pSim->zf = zf;
+    pSim->qwCycles = qwCycles;
+    pSim->qwInsns += qwInsns;
+    return stop;
+
+#undef IMM
+#undef MEM
+#undef IDX
+#undef SETZ
+#undef GOTO
+#undef SYNC
+#undef ALU_ADD
+#undef ALU_ADC
+#undef ALU_SUB
+#undef ALU_SBB
+#undef ALU_CMP
+#undef ALU_LOGIC
+#undef OP
+#undef NEXT
+#undef JUMP
+#undef DISPATCH
+}
+
+// Record kind of an opcode, from its instruction and operand kinds
+static uint8 simop_kind(const opcode_desc* pOpcode)
+{
+    static const uint8 rgALU[][3] =
+    {
+        // A,expr           A,[expr]            A,[X+expr]
+        { m8b_simop_ADD_I,  m8b_simop_ADD_M,    m8b_simop_ADD_X },
+        { m8b_simop_ADC_I,  m8b_simop_ADC_M,    m8b_simop_ADC_X },
+        { m8b_simop_SUB_I,  m8b_simop_SUB_M,    m8b_simop_SUB_X },
+        { m8b_simop_SBB_I,  m8b_simop_SBB_M,    m8b_simop_SBB_X },
+        { m8b_simop_OR_I,   m8b_simop_OR_M,     m8b_simop_OR_X },
+        { m8b_simop_AND_I,  m8b_simop_AND_M,    m8b_simop_AND_X },
+        { m8b_simop_XOR_I,  m8b_simop_XOR_M,    m8b_simop_XOR_X },
+        { m8b_simop_CMP_I,  m8b_simop_CMP_M,    m8b_simop_CMP_X },
+        { m8b_simop_MOVA_I, m8b_simop_MOVA_M,   m8b_simop_MOVA_X },
+    };
+    size_t nRow, nCol;
+    uint8 op1 = pOpcode->op1, op2 = pOpcode->op2;
+
+    switch (pOpcode->itype)
+    {
+    case M8B_ADD: nRow = 0; break;
+    case M8B_ADC: nRow = 1; break;
+    case M8B_SUB: nRow = 2; break;
+    case M8B_SBB: nRow = 3; break;
+    case M8B_OR:  nRow = 4; break;
+    case M8B_AND: nRow = 5; break;
+    case M8B_XOR: nRow = 6; break;
+    case M8B_CMP: nRow = 7; break;
+    case M8B_MOV: nRow = 8; break;
+    case M8B_HALT:  return m8b_simop_HALT;
+    case M8B_NOP:   return m8b_simop_NOP;
+    case M8B_XPAGE: return m8b_simop_XPAGE;
+    case M8B_DI:    return m8b_simop_DI;
+    case M8B_EI:    return m8b_simop_EI;
+    case M8B_INC:
+        return op1 == opk_A ? m8b_simop_INC_A : op1 == opk_X ? m8b_simop_INC_XR : op1 == opk_mem ? m8b_simop_INC_M : m8b_simop_INC_X;
+    case M8B_DEC:
+        return op1 == opk_A ? m8b_simop_DEC_A : op1 == opk_X ? m8b_simop_DEC_XR : op1 == opk_mem ? m8b_simop_DEC_M : m8b_simop_DEC_X;
+    case M8B_CPL:   return m8b_simop_CPL;
+    case M8B_ASL:   return m8b_simop_ASL;
+    case M8B_ASR:   return m8b_simop_ASR;
+    case M8B_RLC:   return m8b_simop_RLC;
+    case M8B_RRC:   return m8b_simop_RRC;
+    case M8B_IORD:  return m8b_simop_IORD;
+    case M8B_IOWR:  return m8b_simop_IOWR;
+    case M8B_IOWX:  return m8b_simop_IOWX;
+    case M8B_PUSH:  return op1 == opk_A ? m8b_simop_PUSH_A : m8b_simop_PUSH_X;
+    case M8B_POP:   return op1 == opk_A ? m8b_simop_POP_A : m8b_simop_POP_X;
+    case M8B_SWAP:  return op2 == opk_X ? m8b_simop_SWAP_AX : m8b_simop_SWAP_AD;
+    case M8B_JMP:   return m8b_simop_JMP;
+    case M8B_JZ:    return m8b_simop_JZ;
+    case M8B_JNZ:   return m8b_simop_JNZ;
+    case M8B_JC:    return m8b_simop_JC;
+    case M8B_JNC:   return m8b_simop_JNC;
+    case M8B_JACC:  return m8b_simop_JACC;
+    case M8B_CALL:  return m8b_simop_CALL;
+    case M8B_RET:   return m8b_simop_RET;
+    case M8B_RETI:  return m8b_simop_RETI;
+    case M8B_IPRET: return m8b_simop_IPRET;
+    case M8B_INDEX: return m8b_simop_INDEX;
+    default:        return m8b_simop_BAD;
+    }
+
+    // OR/AND/XOR [expr],A and the other MOV forms
+    if (op2 == opk_A)
+    {
+        switch (pOpcode->itype)
+        {
+        case M8B_OR:  return op1 == opk_mem ? m8b_simop_OR_MA : m8b_simop_OR_XA;
+        case M8B_AND: return op1 == opk_mem ? m8b_simop_AND_MA : m8b_simop_AND_XA;
+        case M8B_XOR: return op1 == opk_mem ? m8b_simop_XOR_MA : m8b_simop_XOR_XA;
+        case M8B_MOV:
+            return op1 == opk_X ? m8b_simop_MOVX_A : op1 == opk_PSP ? m8b_simop_MOVPSP_A : op1 == opk_mem ? m8b_simop_MOVM_A : m8b_simop_MOVXM_A;
+        }
+        return m8b_simop_BAD;
+    }
+    if (op1 == opk_X)
+        return op2 == opk_imm ? m8b_simop_MOVX_I : m8b_simop_MOVX_M;
+    if (op1 == opk_A && op2 == opk_X)
+        return m8b_simop_MOVA_XR;
+
+    switch (op2)
+    {
+    case opk_imm:   nCol = 0; break;
+    case opk_mem:   nCol = 1; break;
+    case opk_displ: nCol = 2; break;
+    default:        return m8b_simop_BAD;
+    }
+    return rgALU[nRow][nCol];
+}
@@ -0,0 +1,93 @@
+#ifndef SIM_HPP_INCLUDED
+#define SIM_HPP_INCLUDED
+
+// Cycle counting M8B core. The ROM is predecoded once into one record per byte,
+// so the run loop only dispatches on the record kind (threaded with GCC's
+// computed goto, a switch elsewhere). Peripherals are left to the host through
+// the I/O callbacks and m8b_sim_interrupt().
+
+#include "dec.hpp"
+
+// Record kinds, one per instruction and operand form
+#define M8B_SIMOPS(X) \
+    X(BAD)      X(HALT)     X(NOP)      X(XPAGE)    X(DI)       X(EI) \
+    X(ADD_I)    X(ADD_M)    X(ADD_X)    X(ADC_I)    X(ADC_M)    X(ADC_X) \
+    X(SUB_I)    X(SUB_M)    X(SUB_X)    X(SBB_I)    X(SBB_M)    X(SBB_X) \
+    X(OR_I)     X(OR_M)     X(OR_X)     X(AND_I)    X(AND_M)    X(AND_X) \
+    X(XOR_I)    X(XOR_M)    X(XOR_X)    X(CMP_I)    X(CMP_M)    X(CMP_X) \
+    X(OR_MA)    X(OR_XA)    X(AND_MA)   X(AND_XA)   X(XOR_MA)   X(XOR_XA) \
+    X(MOVA_I)   X(MOVA_M)   X(MOVA_X)   X(MOVX_I)   X(MOVX_M)   X(MOVA_XR) \
+    X(MOVX_A)   X(MOVM_A)   X(MOVXM_A)  X(MOVPSP_A) \
+    X(INC_A)    X(INC_XR)   X(INC_M)    X(INC_X)    X(DEC_A)    X(DEC_XR) \
+    X(DEC_M)    X(DEC_X)    X(CPL)      X(ASL)      X(ASR)      X(RLC) \
+    X(RRC)      X(IORD)     X(IOWR)     X(IOWX)     X(PUSH_A)   X(PUSH_X) \
+    X(POP_A)    X(POP_X)    X(SWAP_AX)  X(SWAP_AD)  X(JMP)      X(JZ) \
+    X(JNZ)      X(JC)       X(JNC)      X(JACC)     X(CALL)     X(RET) \
+    X(RETI)     X(IPRET)    X(INDEX)
+
+#define M8B_SIMOP_ENUM(k) m8b_simop_##k,
+enum m8b_simop_kind_t ENUM_SIZE(uint8)
+{
+    M8B_SIMOPS(M8B_SIMOP_ENUM)
+    m8b_simop_last
+};
+#undef M8B_SIMOP_ENUM
+
+// Predecoded instruction. Jump targets and the next PC are resolved up front;
+// both point at the sentinel record past the ROM when they leave it.
+typedef struct m8b_simop_t
+{
+    uint8 kind;         // m8b_simop_kind_t
+    uint8 value;        // operand byte
+    uint8 cycles;
+    uint8 reserved;
+    uint16 addr;        // target of jumps, calls, JACC and INDEX
+    uint16 next;        // PC after the instruction
+}
+m8b_simop;
+
+CASSERT(sizeof(m8b_simop) == 8);
+
+enum m8b_sim_stop_t
+{
+    m8b_sim_budget = 0, // the cycle budget ran out
+    m8b_sim_halted,     // HALT, stopped until reset
+    m8b_sim_badop       // unused opcode or PC outside the ROM
+};
+
+typedef uint8 (*m8b_ioread_cb)(void* pvContext, uint8 port);
+typedef void (*m8b_iowrite_cb)(void* pvContext, uint8 port, uint8 value);
+
+typedef struct m8b_sim_t
+{
+    uint16 pc;
+    uint8 a;
+    uint8 x;
+    uint8 dsp;
+    uint8 psp;
+    uint8 cf;
+    uint8 zf;
+    uint8 ie;           // interrupts enabled (EI/DI/RETI)
+    uint8 fHalted;
+    uint64 qwCycles;
+    uint64 qwInsns;
+    uint8 rgbRAM[0x100];
+    uint8 rgbIO[0x100]; // last value written to each port
+    size_t cbRAM;
+    size_t cbROM;
+    const uint8* pbROM;
+    const m8b_simop* rgOps;
+    m8b_ioread_cb pfnRead;      // NULL reads back the last written value
+    m8b_iowrite_cb pfnWrite;
+    void* pvContext;
+}
+m8b_sim;
+
+// rgOps needs cbROM + 1 records, the last one is a stop sentinel
+void m8b_sim_predecode(const uint8* pbROM, size_t cbROM, m8b_simop* rgOps);
+bool m8b_sim_init(m8b_sim* pSim, const uint8* pbROM, size_t cbROM, size_t cbRAM, const m8b_simop* rgOps);
+void m8b_sim_reset(m8b_sim* pSim);
+bool m8b_sim_interrupt(m8b_sim* pSim, uint16 eaVector);
+int m8b_sim_run(m8b_sim* pSim, uint64 qwUntil);
+
+#endif
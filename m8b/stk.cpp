@@ -0,0 +1,196 @@
+#include "dec.hpp"
+
+static int nInitPSP, nInitDSP;          // first MOV PSP,A / SWAP A,DSP with A known, -1 if none
+
+static void find_stack_bases(const segment_t* pSegment);
+static void report_stack(const char* szStack, int nBase, int nDepth, int nDir, int nOtherBase, int nOtherDepth);
+static bool is_ram_used(ea_t ea);
+static bool is_reset_entry(ea_t ea);
+static bool idaapi menu_stack(void*);
+
+// Deepest program and data stack of every entry point (the vectors from
+// m8b.cfg). A taken interrupt pushes another return address on top of what
+// the code it interrupts uses; handlers that run EI may be interrupted in turn,
+// handlers that set up the stacks again (USB bus reset) start over like reset.
+// The totals are checked against the RAM variables, aliases and the other stack.
+// Each entry is walked like a subroutine (walk_call_effect), its callees come
+// with their stored effects.
+void analyze_stack()
+{
+    char szLine[MAXSTR];
+    qvector<rom_entry> qvEntries;
+    m8b_call_effect effect;
+    segment_t* pSegment;
+    const char* szName;
+    ea_t ea;
+    size_t i;
+    int nPSP = 0, nDSP = 0, nNestPSP = 0, nNestDSP = 0, nIntPSP = 0, nIntDSP = 0, nEntryPSP, nEntryDSP;
+    bool fUnbounded = false, fEntryUnbounded;
+
+    nInitPSP = nInitDSP = -1;
+
+    pSegment = segROM();
+    get_rom_entries(qvEntries);
+    show_wait_box("Computing stack usage");
+    for (i = 0; i < qvEntries.size(); ++i)
+    {
+        ea = qvEntries[i].ea;
+        szName = qvEntries[i].szName;
+
+        walk_call_effect(ea, &effect);
+        nEntryPSP = effect.nPSP;
+        nEntryDSP = effect.nDSP;
+        fEntryUnbounded = (effect.flags & M8B_CE_UNBOUNDED) != 0;
+        fUnbounded |= fEntryUnbounded;
+        if (fEntryUnbounded)
+            qsnprintf(szLine, sizeof(szLine), "Stack unbounded (recursion or pushes in a loop)");
+        else
+            qsnprintf(szLine, sizeof(szLine), "Stack PSP %d, DSP %d bytes", nEntryPSP, nEntryDSP);
+        update_extra_cmt(ea, E_PREV + 1, szLine);
+        msg("%s: program stack %d, data stack %d bytes%s%s\n", szName, nEntryPSP, nEntryDSP,
+            (effect.flags & M8B_CE_EI) ? ", enables interrupts" : "", fEntryUnbounded ? ", unbounded" : "");
+
+        if (is_reset_entry(ea) || (effect.flags & M8B_CE_RESET))
+        {
+            if (nEntryPSP > nPSP) nPSP = nEntryPSP;
+            if (nEntryDSP > nDSP) nDSP = nEntryDSP;
+        }
+        else if (effect.flags & M8B_CE_EI)
+        {
+            nNestPSP += 2 + nEntryPSP;
+            nNestDSP += nEntryDSP;
+        }
+        else
+        {
+            if (2 + nEntryPSP > nIntPSP) nIntPSP = 2 + nEntryPSP;
+            if (nEntryDSP > nIntDSP) nIntDSP = nEntryDSP;
+        }
+    }
+    if (pSegment) find_stack_bases(pSegment);
+    hide_wait_box();
+
+    nPSP += nNestPSP + nIntPSP;
+    nDSP += nNestDSP + nIntDSP;
+    if (nInitPSP < 0) nInitPSP = 0;
+    if (nInitDSP < 0) nInitDSP = 0;
+
+    msg("Worst case with interrupts: program stack %d bytes from %0.2Xh, data stack %d bytes below %0.2Xh%s\n",
+        nPSP, nInitPSP, nDSP, nInitDSP, fUnbounded ? " (some entries unbounded)" : "");
+    report_stack("Program stack", nInitPSP, nPSP, 1, nInitDSP, nDSP);
+    report_stack("Data stack", nInitDSP, nDSP, -1, nInitPSP, nPSP);
+}
+
+void add_stack_menu()
+{
+    add_menu_item("Edit/Other", "M8 stack usage", NULL, SETMENU_APP, menu_stack, NULL);
+}
+
+void del_stack_menu()
+{
+    del_menu_item("Edit/Other/M8 stack usage");
+}
+
+static bool idaapi menu_stack(void*)
+{
+    analyze_stack();
+    return true;
+}
+
+// Where the first MOV PSP,A and SWAP A,DSP with a known A put the stacks; the
+// reset code sets them up before anything else
+static void find_stack_bases(const segment_t* pSegment)
+{
+    m8b_regstate state;
+    m8b_insn insn;
+    ea_t ea;
+
+    for (ea = pSegment->startEA; ea != BADADDR && ea < pSegment->endEA && (nInitPSP < 0 || nInitDSP < 0); ea = next_head(ea, pSegment->endEA))
+    {
+        if (!isCode(getFlags(ea)) || !decode_rom(ea, &insn)) continue;
+
+        if (insn.itype == M8B_SWAP && rgOpcodes[insn.code].op2 == opk_DSP)
+        {
+            if (nInitDSP < 0 && get_regstate(ea, &state) && (state.flags & M8B_RS_A))
+                nInitDSP = state.a;
+        }
+        else if (insn.itype == M8B_MOV && rgOpcodes[insn.code].op1 == opk_PSP)
+        {
+            if (nInitPSP < 0 && get_regstate(ea, &state) && (state.flags & M8B_RS_A))
+                nInitPSP = state.a;
+        }
+    }
+}
+
+// Free bytes between the end of a stack and the first RAM byte in its way: a
+// variable the code refers to, a named location (aliases such as the endpoint
+// FIFOs) or the other stack. The PSP grows up (nDir 1), the DSP down.
+static void report_stack(const char* szStack, int nBase, int nDepth, int nDir, int nOtherBase, int nOtherDepth)
+{
+    char szName[MAXNAMELEN];
+    segment_t* pSegment;
+    int nRAM, nAddr, nEnd, nOtherLow, nOtherHigh;
+    ea_t ea;
+
+    pSegment = segRAM();
+    if (!pSegment) return;
+    nRAM = (int)(pSegment->endEA - pSegment->startEA);
+
+    // The DSP is decremented before it is written, so a base of 0 is the top of RAM
+    if (nDir < 0 && nBase == 0) nBase = nRAM;
+    if (nDir > 0)
+    {
+        nOtherHigh = nOtherBase ? nOtherBase : nRAM;
+        nOtherLow = nOtherHigh - nOtherDepth;
+    }
+    else
+    {
+        nOtherLow = nOtherBase;
+        nOtherHigh = nOtherBase + nOtherDepth;
+    }
+
+    nEnd = nBase + nDir * nDepth;
+    nAddr = nDir > 0 ? nBase : nBase - 1;
+    for (; nAddr >= 0 && nAddr < nRAM; nAddr += nDir)
+    {
+        ea = pSegment->startEA + nAddr;
+        if (nAddr >= nOtherLow && nAddr < nOtherHigh)
+        {
+            qstrncpy(szName, nDir > 0 ? "data stack" : "program stack", sizeof(szName));
+            break;
+        }
+        if (nAddr == nBase || nAddr == nOtherBase || !is_ram_used(ea)) continue;
+        if (!get_true_name(BADADDR, ea, szName, sizeof(szName)))
+            qsnprintf(szName, sizeof(szName), "%0.2Xh", nAddr);
+        break;
+    }
+
+    if (nAddr < 0 || nAddr >= nRAM)
+        qstrncpy(szName, "end of RAM", sizeof(szName));
+
+    // Bytes from the last one the stack writes to the blocking one
+    nAddr = nDir > 0 ? nAddr - nEnd : nEnd - 1 - nAddr;
+    if (nAddr < 0)
+        msg("%s overlaps %s by %d bytes\n", szStack, szName, -nAddr);
+    else
+        msg("%s has %d bytes left before %s\n", szStack, nAddr, szName);
+}
+
+static bool is_ram_used(ea_t ea)
+{
+    flags_t flags = getFlags(ea);
+
+    return has_any_name(flags) || get_first_dref_to(ea) != BADADDR;
+}
+
+// The reset vector, or where its JMP goes when the entry was put on the handler
+static bool is_reset_entry(ea_t ea)
+{
+    segment_t* pSegment = segROM();
+    m8b_insn insn;
+    ea_t eaStart;
+
+    if (!pSegment) return false;
+    eaStart = pSegment->startEA;
+    if (ea == eaStart) return true;
+    return decode_rom(eaStart, &insn) && insn.itype == M8B_JMP && toROM(insn.addr) == ea;
+}
@@ -0,0 +1,178 @@
+#include "dec.hpp"
+
+#define MAXCASES 128    // JACC reaches 256 bytes, two per table entry
+
+static size_t probe_jacc_table(ea_t eaJacc, ea_t eaTable);
+static bool has_foreign_ref(ea_t ea, ea_t eaFrom);
+
+// A JACC table is a run of 2-byte JMPs rather than addresses, so the switch is
+// custom: IDA keeps the case count and we create the xrefs to the entries.
+int idaapi is_switch(switch_info_ex_t* si)
+{
+    segment_t* pSegment;
+    ea_t eaTable, eaDefault;
+    size_t nCases;
+    uint8 max;
+
+    if (cmd.itype != M8B_JACC) return 0;
+
+    eaTable = toROM(cmd.Op1.addr);
+    if (eaTable == BADADDR) return 0;
+    pSegment = getseg(eaTable);
+    if (!pSegment) return 0;
+
+    if (get_a_bound(cmd.ea, &max, &eaDefault))
+        nCases = max / 2 + 1;
+    else
+        nCases = probe_jacc_table(cmd.ea, eaTable);
+
+    if (nCases > (pSegment->endEA - eaTable) / 2)
+        nCases = (pSegment->endEA - eaTable) / 2;
+    if (!nCases) return 0;
+
+    memset(si, 0, sizeof(*si));
+    si->cb = sizeof(*si);
+    si->flags = SWI_EXTENDED | SWI_CUSTOM;
+    si->ncases = (uint16)nCases;
+    si->jumps = eaTable;
+    si->startea = cmd.ea;
+    si->defjump = BADADDR;
+    if (eaDefault != BADADDR)
+    {
+        si->flags |= SWI_DEFAULT;
+        si->defjump = eaDefault;
+    }
+    si->set_expr(rA, dt_byte);
+    si->set_jtable_element_size(2);
+    return 1;
+}
+
+void add_switch_xrefs(ea_t ea, const switch_info_ex_t* si)
+{
+    size_t i;
+
+    for (i = 0; i < si->ncases; i++)
+        add_cref(ea, si->jumps + 2 * i, fl_JN);
+}
+
+// Largest A can be before the instruction at ea (a JACC or INDEX), from an AND
+// mask or a CMP/JNC guard earlier in its block. ASL/ASR scale the bound,
+// anything else writing A drops it.
+bool get_a_bound(ea_t ea, uint8* pMax, ea_t* peaDefault)
+{
+    const opcode_desc* pOpcode;
+    m8b_insn insn;
+    ea_t eaInsn;
+    uint16 max = 0xFF;
+    uint8 cmp = 0;
+    bool fBounded = false, fCmp = false, fPrevCmp;
+
+    *peaDefault = BADADDR;
+    for (eaInsn = find_block_start(ea); eaInsn < ea; eaInsn += insn.size)
+    {
+        if (!decode_rom(eaInsn, &insn)) return false;
+        pOpcode = rgOpcodes + insn.code;
+        fPrevCmp = fCmp;
+        fCmp = false;
+
+        switch (insn.itype)
+        {
+        case M8B_MOV:
+            if (pOpcode->op1 == opk_A && pOpcode->op2 == opk_imm)
+            {
+                max = insn.value;
+                fBounded = true;
+                continue;
+            }
+            break;
+        case M8B_AND:
+            // A & expr never exceeds A
+            if (pOpcode->op1 != opk_A) break;
+            if (pOpcode->op2 == opk_imm)
+            {
+                if (insn.value < max) max = insn.value;
+                fBounded = true;
+            }
+            continue;
+        case M8B_ASL:
+            if (max < 0x80)
+            {
+                max <<= 1;
+                continue;
+            }
+            break;
+        case M8B_ASR:
+            if (max < 0x80)
+            {
+                max >>= 1;
+                continue;
+            }
+            break;
+        case M8B_CMP:
+            if (pOpcode->op1 == opk_A && pOpcode->op2 == opk_imm)
+            {
+                fCmp = true;
+                cmp = insn.value;
+            }
+            continue;
+        case M8B_JNC:
+            // Falls through only for A < expr, the taken branch is the default
+            if (fPrevCmp && cmp)
+            {
+                if (cmp - 1 < max) max = cmp - 1;
+                fBounded = true;
+                *peaDefault = toROM(insn.addr);
+            }
+            continue;
+        }
+
+        if (m8b_writes(&insn) & M8B_RS_A)
+        {
+            max = 0xFF;
+            fBounded = false;
+            *peaDefault = BADADDR;
+        }
+    }
+
+    *pMax = (uint8)max;
+    return fBounded;
+}
+
+// Without a bound the table runs while its entries are JMPs or returns, up to
+// an entry that something other than this JACC refers to (the next table).
+static size_t probe_jacc_table(ea_t eaJacc, ea_t eaTable)
+{
+    flags_t flags;
+    ea_t ea;
+    size_t i;
+
+    for (i = 0; i < MAXCASES; i++)
+    {
+        ea = eaTable + 2 * i;
+        flags = getFlags(ea);
+        if (!hasValue(flags) || !hasValue(getFlags(ea + 1))) break;
+        if (i && (has_user_name(flags) || has_foreign_ref(ea, eaJacc))) break;
+
+        switch (rgOpcodes[get_rom_byte(ea)].itype)
+        {
+        case M8B_JMP:
+        case M8B_RET:
+        case M8B_RETI:
+        case M8B_IPRET:
+            continue;
+        }
+        break;
+    }
+
+    return i;
+}
+
+static bool has_foreign_ref(ea_t ea, ea_t eaFrom)
+{
+    ea_t eaRef;
+
+    for (eaRef = get_first_cref_to(ea); eaRef != BADADDR; eaRef = get_next_cref_to(ea, eaRef))
+        if (eaRef != eaFrom) return true;
+
+    return get_first_dref_to(ea) != BADADDR;
+}
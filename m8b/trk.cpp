@@ -0,0 +1,149 @@
+#include "dec.hpp"
+
+#define MAXBLOCK 64     // instructions walked back to find the start of a block
+
+// The basic block of the last query and the register state before each of its
+// instructions decoded so far. emu() mostly visits a block front to back, so
+// each block is decoded about once instead of backscanning at every site.
+typedef struct block_cache_t
+{
+    ea_t eaStart;
+    ea_t eaNext;                    // first instruction not decoded yet
+    m8b_regstate stNext;            // state before eaNext
+    qvector<ea_t> qvEAs;            // instructions in [eaStart, eaNext)
+    qvector<m8b_regstate> qvStates; // and the state before each of them
+}
+block_cache;
+
+static block_cache blkCache;
+
+static void reset_block(ea_t eaStart);
+
+void invalidate_regstates()
+{
+    reset_block(BADADDR);
+}
+
+// Register values known before the instruction at ea. The block starts with
+// what propagate() found for its entry and is tracked forward from there.
+bool get_regstate(ea_t ea, m8b_regstate* pState)
+{
+    m8b_insn insn;
+    ea_t eaStart;
+    size_t i;
+
+    memset(pState, 0, sizeof(*pState));
+
+    eaStart = find_block_start(ea);
+    if (eaStart != blkCache.eaStart || ea < blkCache.eaStart)
+        reset_block(eaStart);
+
+    if (ea < blkCache.eaNext)
+    {
+        for (i = blkCache.qvEAs.size(); i-- > 0 && blkCache.qvEAs[i] >= ea; )
+        {
+            if (blkCache.qvEAs[i] == ea)
+            {
+                *pState = blkCache.qvStates[i];
+                return pState->flags != 0;
+            }
+        }
+        return false;
+    }
+
+    while (blkCache.eaNext < ea)
+    {
+        if (!decode_rom(blkCache.eaNext, &insn))
+        {
+            reset_block(BADADDR);
+            return false;
+        }
+
+        blkCache.qvEAs.push_back(blkCache.eaNext);
+        blkCache.qvStates.push_back(blkCache.stNext);
+        track_insn(&blkCache.stNext, &insn);
+        blkCache.eaNext += insn.size;
+    }
+
+    if (blkCache.eaNext != ea)
+        return false;
+
+    *pState = blkCache.stNext;
+    return pState->flags != 0;
+}
+
+// m8b_track() with what the database knows on top: subroutine summaries for
+// CALL and the table byte an INDEX with a known A loads
+void track_insn(m8b_regstate* pState, const m8b_insn* pInsn)
+{
+    ea_t ea;
+
+    switch (pInsn->itype)
+    {
+    case M8B_CALL:
+        apply_call_summary(pState, toROM(pInsn->addr));
+        return;
+    case M8B_INDEX:
+        if (pState->flags & M8B_RS_A)
+        {
+            ea = toROM(m8b_table_addr(pInsn->addr, pState->a));
+            if (ea != BADADDR && hasValue(getFlags(ea)))
+            {
+                pState->flags = (pState->flags & ~M8B_RS_APORT) | M8B_RS_A;
+                pState->a = get_rom_byte(ea);
+                return;
+            }
+        }
+        break;
+    }
+
+    m8b_track(pState, pInsn);
+}
+
+// Walk back while the previous instruction flows into ea and nothing else
+// jumps or calls there
+ea_t find_block_start(ea_t ea)
+{
+    ea_t eaPrev;
+    size_t i;
+
+    for (i = 0; i < MAXBLOCK; ++i)
+    {
+        if (!isFlow(getFlags(ea)) || get_first_fcref_to(ea) != BADADDR)
+            break;
+
+        eaPrev = prev_not_tail(ea);
+        if (eaPrev == BADADDR || !isCode(getFlags(eaPrev)))
+            break;
+
+        ea = eaPrev;
+    }
+
+    return ea;
+}
+
+// Decode from the ROM snapshot so cmd is left alone
+bool decode_rom(ea_t ea, m8b_insn* pInsn)
+{
+    const uint8* pbCode;
+    size_t cbLeft;
+    ea_t eaBase;
+
+    eaBase = toROM(0);
+    if (eaBase == BADADDR || ea < eaBase)
+        return false;
+
+    pbCode = get_rom_bytes(ea, &cbLeft);
+    if (!pbCode) return false;
+    return m8b_decode_bytes(ea - eaBase, pbCode, cbLeft, pInsn) != 0;
+}
+
+static void reset_block(ea_t eaStart)
+{
+    blkCache.eaStart = eaStart;
+    blkCache.eaNext = eaStart;
+    memset(&blkCache.stNext, 0, sizeof(blkCache.stNext));
+    if (eaStart != BADADDR) get_block_entry(eaStart, &blkCache.stNext);
+    blkCache.qvEAs.clear();
+    blkCache.qvStates.clear();
+}
@@ -0,0 +1,528 @@
+#include "dec.hpp"
+
+#define TAG_BOUND 'L'       // helper: loop bound set by the user at a loop header
+#define TAG_PATH  'W'       // helper: instructions colored by the last run
+#define MAXNODES  0x2000    // instructions per function graph
+#define PATHCOLOR 0xC0FFFF  // background of the worst path (BGR)
+#define NONODE    size_t(-1)
+
+// One instruction of a function. Cycles are the data sheet counts of rgOpcodes,
+// a CALL adds the worst case of its callee.
+typedef struct wcet_node_t
+{
+    ea_t ea;
+    uint32 dwBase;      // cycles of the instruction and its callee
+    uint32 dwCost;      // dwBase plus the extra iterations of a loop headed here
+    uint32 dwLength;    // longest path from here to an exit
+    size_t iSucc;       // first successor in qvSuccs
+    size_t nSucc;
+}
+wcet_node;
+
+typedef struct wcet_graph_t
+{
+    qvector<wcet_node> qvNodes;
+    qvector<size_t> qvSuccs;    // node indices
+    qvector<uint8> qvBack;      // parallel to qvSuccs, edge closes a loop
+    qvector<size_t> qvOrder;    // nodes in reverse postorder
+    qvector<size_t> qvIndex;    // ROM offset to node
+    size_t nUnbounded;
+}
+wcet_graph;
+
+typedef struct wcet_result_t
+{
+    ea_t ea;
+    uint32 dwCycles;
+    size_t nUnbounded;
+}
+wcet_result;
+
+static qvector<wcet_result> qvResults;  // functions finished in this run
+static qvector<ea_t> qvActive;          // functions being analyzed, to catch recursion
+
+static uint32 get_function_wcet(ea_t ea, size_t* pnUnbounded);
+static bool build_graph(wcet_graph& g, ea_t eaEntry);
+static size_t add_node(wcet_graph& g, ea_t ea);
+static void order_graph(wcet_graph& g);
+static void cost_loops(wcet_graph& g);
+static uint32 infer_loop_bound(wcet_graph& g, size_t iHeader, const qvector<uint8>& qvBody);
+static void mark_worst_path(wcet_graph& g);
+static uint32 add_cycles(uint32 a, uint32 b);
+static uint32 mul_cycles(uint32 a, uint32 n);
+static bool idaapi menu_wcet(void*);
+static bool idaapi menu_loop_bound(void*);
+
+// Worst-case cycles of every entry point (the interrupt vectors from m8b.cfg),
+// following calls and counting each loop with its bound. The worst path of
+// every handler is colored and its total put above the entry.
+void analyze_wcet()
+{
+    char szLine[MAXSTR];
+    qvector<rom_entry> qvEntries;
+    const char* szName;
+    nodeidx_t nEA;
+    ea_t ea;
+    size_t i, nUnbounded;
+    uint32 dwCycles;
+
+    for (nEA = helper.alt1st(TAG_PATH); nEA != BADNODE; nEA = helper.altnxt(nEA, TAG_PATH))
+        del_item_color(nEA);
+    helper.altdel_all(TAG_PATH);
+
+    qvResults.clear();
+    qvActive.clear();
+
+    get_rom_entries(qvEntries);
+    show_wait_box("Computing worst-case cycles");
+    for (i = 0; i < qvEntries.size(); ++i)
+    {
+        ea = qvEntries[i].ea;
+        szName = qvEntries[i].szName;
+
+        nUnbounded = 0;
+        dwCycles = get_function_wcet(ea, &nUnbounded);
+        if (nUnbounded)
+        {
+            qsnprintf(szLine, sizeof(szLine), "WCET %u cycles, %u loops without bound counted once", dwCycles, (uint32)nUnbounded);
+            msg("%s: %u cycles worst case (%u loops without bound)\n", szName, dwCycles, (uint32)nUnbounded);
+        }
+        else
+        {
+            qsnprintf(szLine, sizeof(szLine), "WCET %u cycles", dwCycles);
+            msg("%s: %u cycles worst case\n", szName, dwCycles);
+        }
+        update_extra_cmt(ea, E_PREV, szLine);
+    }
+    hide_wait_box();
+
+    qvResults.clear();
+}
+
+void add_wcet_menu()
+{
+    add_menu_item("Edit/Other", "M8 worst-case cycles", NULL, SETMENU_APP, menu_wcet, NULL);
+    add_menu_item("Edit/Other", "M8 loop bound...", NULL, SETMENU_APP, menu_loop_bound, NULL);
+}
+
+void del_wcet_menu()
+{
+    del_menu_item("Edit/Other/M8 worst-case cycles");
+    del_menu_item("Edit/Other/M8 loop bound...");
+}
+
+static bool idaapi menu_wcet(void*)
+{
+    analyze_wcet();
+    return true;
+}
+
+// The bound is the most times the loop header runs per entry; 0 infers it again
+static bool idaapi menu_loop_bound(void*)
+{
+    ea_t ea = get_screen_ea();
+    sval_t nBound = helper.altval(ea, TAG_BOUND);
+
+    if (!asklong(&nBound, "Maximum iterations of the loop at %a (0 to infer)", ea))
+        return false;
+
+    if (nBound > 0)
+        helper.altset(ea, nBound, TAG_BOUND);
+    else
+        helper.altdel(ea, TAG_BOUND);
+    return true;
+}
+
+static uint32 get_function_wcet(ea_t ea, size_t* pnUnbounded)
+{
+    wcet_graph g;
+    wcet_result result;
+    size_t i;
+
+    for (i = 0; i < qvResults.size(); ++i)
+    {
+        if (qvResults[i].ea == ea)
+        {
+            *pnUnbounded += qvResults[i].nUnbounded;
+            return qvResults[i].dwCycles;
+        }
+    }
+
+    // Recursion has no bound either
+    for (i = 0; i < qvActive.size(); ++i)
+    {
+        if (qvActive[i] == ea)
+        {
+            ++*pnUnbounded;
+            return 0;
+        }
+    }
+
+    qvActive.push_back(ea);
+    g.nUnbounded = 0;
+    result.ea = ea;
+    result.dwCycles = 0;
+    if (build_graph(g, ea))
+    {
+        order_graph(g);
+        cost_loops(g);
+        result.dwCycles = g.qvNodes[0].dwLength;
+        if (qvActive.size() == 1) mark_worst_path(g);
+    }
+    else
+        ++g.nUnbounded;
+    result.nUnbounded = g.nUnbounded;
+    qvActive.pop_back();
+
+    qvResults.push_back(result);
+    *pnUnbounded += result.nUnbounded;
+    return result.dwCycles;
+}
+
+// Instructions reachable from the entry without entering calls. Jumps and the
+// cases of a JACC switch come from the code xrefs emu() created.
+static bool build_graph(wcet_graph& g, ea_t eaEntry)
+{
+    segment_t* pSegment;
+    m8b_insn insn;
+    wcet_node* pNode;
+    ea_t ea, eaTo;
+    size_t i, iSucc;
+
+    pSegment = segROM();
+    if (!pSegment) return false;
+
+    g.qvIndex.resize(pSegment->endEA - pSegment->startEA, NONODE);
+    add_node(g, eaEntry);
+
+    for (i = 0; i < g.qvNodes.size(); ++i)
+    {
+        ea = g.qvNodes[i].ea;
+        g.qvNodes[i].iSucc = g.qvSuccs.size();
+        if (!decode_rom(ea, &insn)) continue;
+        g.qvNodes[i].dwBase = rgOpcodes[insn.code].cycles;
+
+        if (insn.itype == M8B_CALL)
+        {
+            eaTo = toROM(insn.addr);
+            if (eaTo != BADADDR)
+                g.qvNodes[i].dwBase = add_cycles(g.qvNodes[i].dwBase, get_function_wcet(eaTo, &g.nUnbounded));
+        }
+        else
+        {
+            for (eaTo = get_first_fcref_from(ea); eaTo != BADADDR; eaTo = get_next_fcref_from(ea, eaTo))
+            {
+                iSucc = add_node(g, eaTo);
+                if (iSucc == NONODE) return false;
+                g.qvSuccs.push_back(iSucc);
+            }
+        }
+
+        if (!(rgInstructions[insn.itype].feature & CF_STOP))
+        {
+            iSucc = add_node(g, ea + insn.size);
+            if (iSucc == NONODE) return false;
+            g.qvSuccs.push_back(iSucc);
+        }
+
+        pNode = &g.qvNodes[i];
+        pNode->nSucc = g.qvSuccs.size() - pNode->iSucc;
+    }
+
+    g.qvBack.resize(g.qvSuccs.size(), 0);
+    return true;
+}
+
+static size_t add_node(wcet_graph& g, ea_t ea)
+{
+    wcet_node node;
+    size_t nOffset;
+
+    nOffset = ea - segROM()->startEA;
+    if (nOffset >= g.qvIndex.size())
+        return NONODE;
+
+    if (g.qvIndex[nOffset] == NONODE)
+    {
+        if (g.qvNodes.size() >= MAXNODES) return NONODE;
+        memset(&node, 0, sizeof(node));
+        node.ea = ea;
+        g.qvIndex[nOffset] = g.qvNodes.size();
+        g.qvNodes.push_back(node);
+    }
+
+    return g.qvIndex[nOffset];
+}
+
+// Depth-first from the entry: an edge back to a node still on the stack closes
+// a loop, and reverse postorder sorts the remaining edges topologically.
+static void order_graph(wcet_graph& g)
+{
+    qvector<uint8> qvState;     // 0 new, 1 on the stack, 2 done
+    qvector<size_t> qvStack;    // nodes
+    qvector<size_t> qvNext;     // next successor of each stacked node
+    size_t iNode, iEdge, iSucc;
+
+    qvState.resize(g.qvNodes.size(), 0);
+    g.qvOrder.clear();
+
+    qvStack.push_back(0);
+    qvNext.push_back(0);
+    qvState[0] = 1;
+    while (!qvStack.empty())
+    {
+        iNode = qvStack.back();
+        if (qvNext.back() == g.qvNodes[iNode].nSucc)
+        {
+            qvState[iNode] = 2;
+            g.qvOrder.push_back(iNode);
+            qvStack.pop_back();
+            qvNext.pop_back();
+            continue;
+        }
+
+        iEdge = g.qvNodes[iNode].iSucc + qvNext.back()++;
+        iSucc = g.qvSuccs[iEdge];
+        if (qvState[iSucc] == 1)
+            g.qvBack[iEdge] = 1;
+        else if (qvState[iSucc] == 0)
+        {
+            qvState[iSucc] = 1;
+            qvStack.push_back(iSucc);
+            qvNext.push_back(0);
+        }
+    }
+
+    for (iNode = 0; iNode < g.qvOrder.size() / 2; ++iNode)
+    {
+        iSucc = g.qvOrder[iNode];
+        g.qvOrder[iNode] = g.qvOrder[g.qvOrder.size() - 1 - iNode];
+        g.qvOrder[g.qvOrder.size() - 1 - iNode] = iSucc;
+    }
+}
+
+// Each loop header is charged (bound - 1) times the longest trip around its
+// loop, inner loops first so an outer body already includes them. Then the
+// longest path to an exit is taken over the edges that do not close a loop.
+static void cost_loops(wcet_graph& g)
+{
+    qvector<qvector<uint8> > qvBodies;
+    qvector<size_t> qvHeaders, qvSizes, qvStack;
+    qvector<uint32> qvDist;
+    qvector<size_t> qvPreds, qvPredStart, qvFill;
+    size_t i, j, k, iNode, iSucc, iHeader;
+    uint32 dwLoop, dwBound, dwMax;
+
+    for (i = 0; i < g.qvNodes.size(); ++i)
+        g.qvNodes[i].dwCost = g.qvNodes[i].dwBase;
+
+    // Predecessors over every edge
+    qvPredStart.resize(g.qvNodes.size() + 1, 0);
+    for (i = 0; i < g.qvSuccs.size(); ++i)
+        ++qvPredStart[g.qvSuccs[i] + 1];
+    for (i = 0; i < g.qvNodes.size(); ++i)
+        qvPredStart[i + 1] += qvPredStart[i];
+    qvPreds.resize(g.qvSuccs.size());
+    qvFill = qvPredStart;
+    for (i = 0; i < g.qvNodes.size(); ++i)
+        for (j = 0; j < g.qvNodes[i].nSucc; ++j)
+            qvPreds[qvFill[g.qvSuccs[g.qvNodes[i].iSucc + j]]++] = i;
+
+    // Natural loop of each header: what reaches its back edges without passing it
+    for (iNode = 0; iNode < g.qvNodes.size(); ++iNode)
+    {
+        for (k = 0; k < g.qvNodes[iNode].nSucc; ++k)
+        {
+            if (!g.qvBack[g.qvNodes[iNode].iSucc + k]) continue;
+            iHeader = g.qvSuccs[g.qvNodes[iNode].iSucc + k];
+            for (i = 0; i < qvHeaders.size() && qvHeaders[i] != iHeader; ++i)
+                ;
+            if (i == qvHeaders.size())
+            {
+                qvHeaders.push_back(iHeader);
+                qvBodies.push_back(qvector<uint8>());
+                qvBodies.back().resize(g.qvNodes.size(), 0);
+                qvBodies.back()[iHeader] = 1;
+                qvSizes.push_back(1);
+            }
+
+            qvStack.clear();
+            qvStack.push_back(iNode);
+            while (!qvStack.empty())
+            {
+                iSucc = qvStack.back();
+                qvStack.pop_back();
+                if (qvBodies[i][iSucc]) continue;
+                qvBodies[i][iSucc] = 1;
+                ++qvSizes[i];
+                for (j = qvPredStart[iSucc]; j < qvPredStart[iSucc + 1]; ++j)
+                    qvStack.push_back(qvPreds[j]);
+            }
+        }
+    }
+
+    qvDist.resize(g.qvNodes.size());
+    while (!qvHeaders.empty())
+    {
+        // Innermost remaining loop
+        for (i = 0, j = 1; j < qvHeaders.size(); ++j)
+            if (qvSizes[j] < qvSizes[i]) i = j;
+        iHeader = qvHeaders[i];
+
+        // Longest trip from the header around to one of its back edges
+        for (j = 0; j < qvDist.size(); ++j) qvDist[j] = 0;
+        qvDist[iHeader] = g.qvNodes[iHeader].dwBase;
+        dwLoop = 0;
+        for (j = 0; j < g.qvOrder.size(); ++j)
+        {
+            iNode = g.qvOrder[j];
+            if (!qvBodies[i][iNode] || !qvDist[iNode]) continue;
+            for (k = 0; k < g.qvNodes[iNode].nSucc; ++k)
+            {
+                iSucc = g.qvSuccs[g.qvNodes[iNode].iSucc + k];
+                if (g.qvBack[g.qvNodes[iNode].iSucc + k])
+                {
+                    if (iSucc == iHeader && qvDist[iNode] > dwLoop) dwLoop = qvDist[iNode];
+                }
+                else if (qvBodies[i][iSucc])
+                {
+                    dwMax = add_cycles(qvDist[iNode], g.qvNodes[iSucc].dwCost);
+                    if (dwMax > qvDist[iSucc]) qvDist[iSucc] = dwMax;
+                }
+            }
+        }
+
+        dwBound = (uint32)helper.altval(g.qvNodes[iHeader].ea, TAG_BOUND);
+        if (!dwBound) dwBound = infer_loop_bound(g, iHeader, qvBodies[i]);
+        if (!dwBound)
+        {
+            ++g.nUnbounded;
+            dwBound = 1;
+        }
+        g.qvNodes[iHeader].dwCost = add_cycles(g.qvNodes[iHeader].dwCost, mul_cycles(dwLoop, dwBound - 1));
+
+        qvHeaders.erase(qvHeaders.begin() + i);
+        qvBodies.erase(qvBodies.begin() + i);
+        qvSizes.erase(qvSizes.begin() + i);
+    }
+
+    for (j = g.qvOrder.size(); j-- > 0; )
+    {
+        iNode = g.qvOrder[j];
+        dwMax = 0;
+        for (k = 0; k < g.qvNodes[iNode].nSucc; ++k)
+        {
+            iSucc = g.qvSuccs[g.qvNodes[iNode].iSucc + k];
+            if (!g.qvBack[g.qvNodes[iNode].iSucc + k] && g.qvNodes[iSucc].dwLength > dwMax)
+                dwMax = g.qvNodes[iSucc].dwLength;
+        }
+        g.qvNodes[iNode].dwLength = add_cycles(g.qvNodes[iNode].dwCost, dwMax);
+    }
+}
+
+// A counted loop closes with DEC/INC reg; JNZ header, the register is written
+// nowhere else in the loop and is known on every edge into the header.
+static uint32 infer_loop_bound(wcet_graph& g, size_t iHeader, const qvector<uint8>& qvBody)
+{
+    const opcode_desc* pOpcode;
+    m8b_regstate state;
+    m8b_insn insn;
+    size_t i, j, iLatch = NONODE, iStep;
+    ea_t eaStep;
+    uint32 dwBound = 0, dwCount;
+    uint8 mask, value;
+    bool fDec;
+
+    for (i = 0; i < g.qvNodes.size(); ++i)
+    {
+        for (j = 0; j < g.qvNodes[i].nSucc; ++j)
+        {
+            if (g.qvBack[g.qvNodes[i].iSucc + j] && g.qvSuccs[g.qvNodes[i].iSucc + j] == iHeader)
+            {
+                if (iLatch != NONODE) return 0;
+                iLatch = i;
+            }
+        }
+    }
+    if (iLatch == NONODE) return 0;
+
+    if (!decode_rom(g.qvNodes[iLatch].ea, &insn) || insn.itype != M8B_JNZ)
+        return 0;
+
+    eaStep = prev_not_tail(g.qvNodes[iLatch].ea);
+    if (eaStep == BADADDR || !decode_rom(eaStep, &insn)) return 0;
+    iStep = g.qvIndex[eaStep - segROM()->startEA];
+    if (iStep == NONODE || !qvBody[iStep]) return 0;
+
+    pOpcode = rgOpcodes + insn.code;
+    if (insn.itype != M8B_DEC && insn.itype != M8B_INC) return 0;
+    if (pOpcode->op1 == opk_A) mask = M8B_RS_A;
+    else if (pOpcode->op1 == opk_X) mask = M8B_RS_X;
+    else return 0;
+    fDec = insn.itype == M8B_DEC;
+
+    for (i = 0; i < g.qvNodes.size(); ++i)
+    {
+        if (!qvBody[i] || i == iStep) continue;
+        if (!decode_rom(g.qvNodes[i].ea, &insn) || (m8b_writes(&insn) & mask)) return 0;
+    }
+
+    for (i = 0; i < g.qvNodes.size(); ++i)
+    {
+        if (qvBody[i]) continue;
+        for (j = 0; j < g.qvNodes[i].nSucc; ++j)
+        {
+            if (g.qvSuccs[g.qvNodes[i].iSucc + j] != iHeader) continue;
+
+            // Nothing known before the edge is still a valid state to track from
+            get_regstate(g.qvNodes[i].ea, &state);
+            if (!decode_rom(g.qvNodes[i].ea, &insn)) return 0;
+            track_insn(&state, &insn);
+            if (!(state.flags & mask)) return 0;
+
+            value = mask == M8B_RS_A ? state.a : state.x;
+            if (fDec) dwCount = value ? value : 0x100;
+            else dwCount = 0x100 - value;
+            if (dwCount > dwBound) dwBound = dwCount;
+        }
+    }
+
+    return dwBound;
+}
+
+static void mark_worst_path(wcet_graph& g)
+{
+    size_t iNode, iNext, k;
+    uint32 dwMax;
+
+    iNode = 0;
+    while (iNode != NONODE)
+    {
+        set_item_color(g.qvNodes[iNode].ea, PATHCOLOR);
+        helper.altset(g.qvNodes[iNode].ea, 1, TAG_PATH);
+
+        iNext = NONODE;
+        dwMax = 0;
+        for (k = 0; k < g.qvNodes[iNode].nSucc; ++k)
+        {
+            if (g.qvBack[g.qvNodes[iNode].iSucc + k]) continue;
+            if (iNext == NONODE || g.qvNodes[g.qvSuccs[g.qvNodes[iNode].iSucc + k]].dwLength > dwMax)
+            {
+                iNext = g.qvSuccs[g.qvNodes[iNode].iSucc + k];
+                dwMax = g.qvNodes[iNext].dwLength;
+            }
+        }
+        iNode = iNext;
+    }
+}
+
+// Saturating, so a loop nest with absurd bounds can't wrap around
+static uint32 add_cycles(uint32 a, uint32 b)
+{
+    return a + b < a ? 0xFFFFFFFF : a + b;
+}
+
+static uint32 mul_cycles(uint32 a, uint32 n)
+{
+    return n && a > 0xFFFFFFFF / n ? 0xFFFFFFFF : a * n;
+}
@@ -0,0 +1,292 @@
+// Batch disassembly of firmware corpora. Every image gets a recursive descent
+// from the CY7C63723 vectors (m8b_descend) and, with -o, a listing and an xref
+// file. Images are spread over the worker threads up front; a worker that runs
+// out steals from the far end of another worker's queue.
+//
+// usage: m8bbatch [-j threads] [-o dir] [-s count] [image ...]
+//   -j  worker threads (default: all cores)
+//   -o  write <dir>/<image>.lst and <dir>/<image>.xref
+//   -s  add synthetic 8K ROMs
+// Without images the bundled examples are disassembled.
+
+#include "image.hpp"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+typedef struct batch_task_t
+{
+    std::string strPath;    // empty for a synthetic image
+    uint32 dwSeed;
+}
+batch_task;
+
+typedef struct batch_queue_t
+{
+    std::mutex mtx;
+    std::deque<size_t> dqTasks;
+}
+batch_queue;
+
+typedef struct batch_worker_t
+{
+    size_t nImages;
+    size_t nInsns;
+    size_t nRefs;
+    size_t nSteals;
+    size_t nFailed;
+}
+batch_worker;
+
+typedef struct batch_ctx_t
+{
+    std::vector<batch_task> vTasks;
+    std::vector<batch_queue> vQueues;
+    std::vector<batch_worker> vWorkers;
+    const char* szOutDir;
+    std::mutex mtxErrors;
+}
+batch_ctx;
+
+static const char* rgszRefTypes[] = { "flow", "jump", "call", "table", "ram", "io" };
+
+static void collect_ref(void* pvContext, const m8b_insn* pInsn, const m8b_ref* pRef)
+{
+    std::vector<std::pair<uint16, m8b_ref> >& vRefs = *(std::vector<std::pair<uint16, m8b_ref> >*)pvContext;
+
+    if (pRef->type != rt_flow)
+        vRefs.push_back(std::make_pair(pInsn->ea, *pRef));
+}
+
+static bool write_listing(const char* szPath, const rom_image& image, const m8b_decoder* pDecoder, const std::vector<uint8>& vbFlags)
+{
+    m8b_insn insn;
+    char szLine[64];
+    size_t ea;
+    uint8 flags;
+    FILE* fp;
+
+    fp = fopen(szPath, "w");
+    if (!fp) return false;
+
+    for (ea = 0; ea < image.cbUsed; ++ea)
+    {
+        flags = vbFlags[ea];
+        if (flags & M8B_DF_ENTRY) fprintf(fp, "\nvec_%04zX:\n", ea);
+        else if (flags & M8B_DF_CALL) fprintf(fp, "\nsub_%04zX:\n", ea);
+        else if (flags & M8B_DF_CASE) fprintf(fp, "case_%04zX:\n", ea);
+        else if (flags & M8B_DF_JUMP) fprintf(fp, "loc_%04zX:\n", ea);
+        else if (flags & M8B_DF_TABLE) fprintf(fp, "tbl_%04zX:\n", ea);
+
+        if ((flags & M8B_DF_CODE) && m8b_decode(pDecoder, ea, &insn))
+        {
+            m8b_render(&insn, szLine, sizeof(szLine));
+            if (insn.size > 1)
+                fprintf(fp, "    %04zX  %02X %02X  %s\n", ea, image.vbROM[ea], image.vbROM[ea + 1], szLine);
+            else
+                fprintf(fp, "    %04zX  %02X     %s\n", ea, image.vbROM[ea], szLine);
+            ea += insn.size - 1;
+        }
+        else if (!(flags & M8B_DF_TAIL))
+            fprintf(fp, "    %04zX  %02X     db %02Xh\n", ea, image.vbROM[ea], image.vbROM[ea]);
+    }
+
+    return fclose(fp) == 0;
+}
+
+static bool ref_less(const std::pair<uint16, m8b_ref>& a, const std::pair<uint16, m8b_ref>& b)
+{
+    return a.first != b.first ? a.first < b.first : a.second.to < b.second.to;
+}
+
+// One line per reference, in address order: from, to, type and r/w for data
+static bool write_xrefs(const char* szPath, std::vector<std::pair<uint16, m8b_ref> >& vRefs)
+{
+    const m8b_ref* pRef;
+    size_t i;
+    FILE* fp;
+
+    fp = fopen(szPath, "w");
+    if (!fp) return false;
+
+    std::sort(vRefs.begin(), vRefs.end(), ref_less);
+    for (i = 0; i < vRefs.size(); ++i)
+    {
+        pRef = &vRefs[i].second;
+        fprintf(fp, "%04X %04X %s%s\n", vRefs[i].first, pRef->to, rgszRefTypes[pRef->type],
+                (pRef->type == rt_ram || pRef->type == rt_io) ? (pRef->fWrite ? " w" : " r") : "");
+    }
+
+    return fclose(fp) == 0;
+}
+
+static bool run_task(batch_ctx& ctx, const batch_task& task, batch_worker& worker)
+{
+    std::vector<std::pair<uint16, m8b_ref> > vRefs;
+    std::vector<uint8> vbFlags;
+    std::vector<uint16> vWork;
+    std::string strError, strBase;
+    uint16 rgeaRoots[VECTOR_ROOTS];
+    m8b_decoder decoder;
+    rom_image image;
+    size_t nRoots;
+
+    if (task.strPath.empty())
+        synth_image(task.dwSeed, ROM_SIZE_MAX, image);
+    else if (!load_image(task.strPath.c_str(), image, strError))
+    {
+        std::lock_guard<std::mutex> lock(ctx.mtxErrors);
+        fprintf(stderr, "%s\n", strError.c_str());
+        return false;
+    }
+
+    nRoots = get_vector_roots(image.cbUsed, rgeaRoots);
+
+    vbFlags.resize(image.cbUsed + 1);
+    vWork.resize(image.cbUsed + 1);
+    vRefs.reserve(image.cbUsed);
+    m8b_init(&decoder, &image.vbROM[0], image.cbUsed);
+    worker.nInsns += m8b_descend(&decoder, rgeaRoots, nRoots, &vbFlags[0], &vWork[0], collect_ref, &vRefs);
+    worker.nRefs += vRefs.size();
+    ++worker.nImages;
+
+    if (!ctx.szOutDir)
+        return true;
+
+    strBase = std::string(ctx.szOutDir) + "/" + image.strName;
+    if (!write_listing((strBase + ".lst").c_str(), image, &decoder, vbFlags) ||
+        !write_xrefs((strBase + ".xref").c_str(), vRefs))
+    {
+        std::lock_guard<std::mutex> lock(ctx.mtxErrors);
+        fprintf(stderr, "can not write %s.lst/.xref\n", strBase.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// Own queue from the front, other queues from the back
+static bool next_task(batch_ctx& ctx, size_t iWorker, size_t* piTask)
+{
+    size_t i, iVictim;
+
+    for (i = 0; i < ctx.vQueues.size(); ++i)
+    {
+        iVictim = (iWorker + i) % ctx.vQueues.size();
+        batch_queue& queue = ctx.vQueues[iVictim];
+        std::lock_guard<std::mutex> lock(queue.mtx);
+
+        if (queue.dqTasks.empty()) continue;
+        if (i == 0)
+        {
+            *piTask = queue.dqTasks.front();
+            queue.dqTasks.pop_front();
+        }
+        else
+        {
+            *piTask = queue.dqTasks.back();
+            queue.dqTasks.pop_back();
+            ++ctx.vWorkers[iWorker].nSteals;
+        }
+        return true;
+    }
+
+    return false;
+}
+
+static void run_worker(batch_ctx* pCtx, size_t iWorker)
+{
+    size_t iTask;
+
+    while (next_task(*pCtx, iWorker, &iTask))
+        if (!run_task(*pCtx, pCtx->vTasks[iTask], pCtx->vWorkers[iWorker]))
+            ++pCtx->vWorkers[iWorker].nFailed;
+}
+
+int main(int argc, char* argv[])
+{
+    static const char* rgszDefaults[] = { "../examples/logo.hex", "../examples/mouse.hex" };
+    typedef std::chrono::steady_clock clock;
+    std::vector<std::thread> vThreads;
+    clock::time_point tStart;
+    batch_ctx ctx;
+    batch_task task;
+    batch_worker total;
+    size_t i, nThreads, nSynth = 0;
+    double dSeconds;
+    int c;
+
+    nThreads = std::thread::hardware_concurrency();
+    ctx.szOutDir = NULL;
+    for (c = 1; c < argc && argv[c][0] == '-'; ++c)
+    {
+        if (!strcmp(argv[c], "-j") && c + 1 < argc)
+            nThreads = (size_t)atoi(argv[++c]);
+        else if (!strcmp(argv[c], "-o") && c + 1 < argc)
+            ctx.szOutDir = argv[++c];
+        else if (!strcmp(argv[c], "-s") && c + 1 < argc)
+            nSynth = (size_t)atoi(argv[++c]);
+        else
+        {
+            fprintf(stderr, "usage: %s [-j threads] [-o dir] [-s count] [image ...]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (!nThreads) nThreads = 1;
+
+    task.dwSeed = 0;
+    if (c == argc && !nSynth)
+    {
+        for (i = 0; i < sizeof(rgszDefaults) / sizeof(rgszDefaults[0]); ++i)
+        {
+            task.strPath = rgszDefaults[i];
+            ctx.vTasks.push_back(task);
+        }
+    }
+    for (; c < argc; ++c)
+    {
+        task.strPath = argv[c];
+        ctx.vTasks.push_back(task);
+    }
+    task.strPath.clear();
+    for (i = 0; i < nSynth; ++i)
+    {
+        task.dwSeed = (uint32)(i + 1);
+        ctx.vTasks.push_back(task);
+    }
+
+    // Round robin, so every worker starts with a share and stealing only evens out the tail
+    ctx.vQueues = std::vector<batch_queue>(nThreads);
+    ctx.vWorkers.resize(nThreads);
+    memset(&ctx.vWorkers[0], 0, nThreads * sizeof(batch_worker));
+    for (i = 0; i < ctx.vTasks.size(); ++i)
+        ctx.vQueues[i % nThreads].dqTasks.push_back(i);
+
+    tStart = clock::now();
+    for (i = 0; i < nThreads; ++i)
+        vThreads.push_back(std::thread(run_worker, &ctx, i));
+    for (i = 0; i < nThreads; ++i)
+        vThreads[i].join();
+    dSeconds = std::chrono::duration<double>(clock::now() - tStart).count();
+
+    memset(&total, 0, sizeof(total));
+    for (i = 0; i < nThreads; ++i)
+    {
+        total.nImages += ctx.vWorkers[i].nImages;
+        total.nInsns += ctx.vWorkers[i].nInsns;
+        total.nRefs += ctx.vWorkers[i].nRefs;
+        total.nSteals += ctx.vWorkers[i].nSteals;
+        total.nFailed += ctx.vWorkers[i].nFailed;
+    }
+
+    printf("%zu images, %zu instructions, %zu xrefs, %zu threads, %zu steals, %.3f ms, %.0f insns/s\n",
+           total.nImages, total.nInsns, total.nRefs, nThreads, total.nSteals, dSeconds * 1e3,
+           dSeconds ? total.nInsns / dSeconds : 0.0);
+
+    return total.nFailed ? 1 : 0;
+}
@@ -0,0 +1,186 @@
+// Decoder benchmark. Runs the decode, xref and render phases over the bundled
+// example firmware and synthetic 8K ROMs and reports throughput per phase.
+//
+// usage: m8bbench [-j] [-t seconds] [-s count] [image ...]
+//   -j  one JSON object per line instead of a table
+//   -t  minimum run time per phase (default 0.25)
+//   -s  number of synthetic 8K ROMs (default 2)
+
+#include "image.hpp"
+#include <chrono>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static size_t cAllocs;
+
+extern "C" void* __real_malloc(size_t cb);
+extern "C" void* __wrap_malloc(size_t cb)
+{
+    ++cAllocs;
+    return __real_malloc(cb);
+}
+
+void* operator new(size_t cb)
+{
+    void* p;
+
+    ++cAllocs;
+    p = malloc(cb ? cb : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+typedef struct phase_result_t
+{
+    const char* szPhase;
+    size_t nInsns;              // instructions per iteration
+    size_t nIterations;
+    double dSeconds;
+    size_t cAllocs;
+    size_t nSink;               // keeps the work observable
+}
+phase_result;
+
+enum { phDecode = 0, phXrefs, phRender, phLast };
+
+static const char* rgszPhases[] = { "decode", "xrefs", "render" };
+
+static size_t run_phase(int phase, const m8b_decoder* pDecoder, const rom_image& image, std::vector<m8b_insn>& vInsns)
+{
+    m8b_ref rgRefs[M8B_MAXREFS];
+    char szLine[64];
+    size_t i, n = 0;
+
+    switch (phase)
+    {
+    case phDecode:
+        n = m8b_decode_all(pDecoder, 0, image.cbUsed, &vInsns[0], vInsns.size());
+        break;
+    case phXrefs:
+        for (i = 0; i < vInsns.size(); ++i)
+            n += m8b_xrefs(&vInsns[i], rgRefs);
+        break;
+    case phRender:
+        for (i = 0; i < vInsns.size(); ++i)
+            n += m8b_render(&vInsns[i], szLine, sizeof(szLine));
+        break;
+    }
+
+    return n;
+}
+
+static void bench_image(const rom_image& image, double dMinSeconds, bool fJson)
+{
+    typedef std::chrono::steady_clock clock;
+    std::vector<m8b_insn> vInsns(image.cbUsed ? image.cbUsed : 1);
+    m8b_decoder decoder;
+    phase_result result;
+    clock::time_point tStart;
+    size_t nAllocs;
+    int phase;
+
+    m8b_init(&decoder, &image.vbROM[0], image.vbROM.size());
+    vInsns.resize(m8b_decode_all(&decoder, 0, image.cbUsed, &vInsns[0], vInsns.size()));
+
+    for (phase = 0; phase < phLast; ++phase)
+    {
+        memset(&result, 0, sizeof(result));
+        result.szPhase = rgszPhases[phase];
+        result.nInsns = vInsns.size();
+
+        nAllocs = cAllocs;
+        tStart = clock::now();
+        do
+        {
+            result.nSink += run_phase(phase, &decoder, image, vInsns);
+            ++result.nIterations;
+            result.dSeconds = std::chrono::duration<double>(clock::now() - tStart).count();
+        }
+        while (result.dSeconds < dMinSeconds);
+        result.cAllocs = cAllocs - nAllocs;
+
+        double dInsns = (double)result.nInsns * result.nIterations;
+        double dNsPerInsn = dInsns ? result.dSeconds * 1e9 / dInsns : 0;
+        double dInsnsPerSec = result.dSeconds ? dInsns / result.dSeconds : 0;
+        double dAllocsPerIter = (double)result.cAllocs / result.nIterations;
+
+        if (fJson)
+            printf("{\"image\":\"%s\",\"bytes\":%zu,\"phase\":\"%s\",\"insns\":%zu,\"iterations\":%zu,"
+                   "\"seconds\":%.6f,\"ns_per_insn\":%.3f,\"insns_per_sec\":%.0f,\"allocs_per_iteration\":%.2f}\n",
+                   image.strName.c_str(), image.cbUsed, result.szPhase, result.nInsns, result.nIterations,
+                   result.dSeconds, dNsPerInsn, dInsnsPerSec, dAllocsPerIter);
+        else
+            printf("%-20s %-7s %7zu %10zu %10.2f %14.0f %10.2f\n",
+                   image.strName.c_str(), result.szPhase, result.nInsns, result.nIterations,
+                   dNsPerInsn, dInsnsPerSec, dAllocsPerIter);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<rom_image> vImages;
+    std::string strError;
+    rom_image image;
+    double dMinSeconds = 0.25;
+    size_t i, nSynth = 2;
+    bool fJson = false;
+    int c;
+
+    for (c = 1; c < argc && argv[c][0] == '-'; ++c)
+    {
+        if (!strcmp(argv[c], "-j"))
+            fJson = true;
+        else if (!strcmp(argv[c], "-t") && c + 1 < argc)
+            dMinSeconds = atof(argv[++c]);
+        else if (!strcmp(argv[c], "-s") && c + 1 < argc)
+            nSynth = (size_t)atoi(argv[++c]);
+        else
+        {
+            fprintf(stderr, "usage: %s [-j] [-t seconds] [-s count] [image ...]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (c == argc)
+    {
+        static const char* rgszDefaults[] = { "../examples/logo.hex", "../examples/mouse.hex" };
+        for (i = 0; i < sizeof(rgszDefaults) / sizeof(rgszDefaults[0]); ++i)
+        {
+            if (!load_image(rgszDefaults[i], image, strError))
+            {
+                fprintf(stderr, "%s\n", strError.c_str());
+                return 1;
+            }
+            vImages.push_back(image);
+        }
+    }
+
+    for (; c < argc; ++c)
+    {
+        if (!load_image(argv[c], image, strError))
+        {
+            fprintf(stderr, "%s\n", strError.c_str());
+            return 1;
+        }
+        vImages.push_back(image);
+    }
+
+    for (i = 0; i < nSynth; ++i)
+    {
+        synth_image((uint32)(i + 1), ROM_SIZE_MAX, image);
+        vImages.push_back(image);
+    }
+
+    if (!fJson)
+        printf("%-20s %-7s %7s %10s %10s %14s %10s\n", "image", "phase", "insns", "iter", "ns/insn", "insns/s", "allocs/it");
+
+    for (i = 0; i < vImages.size(); ++i)
+        bench_image(vImages[i], dMinSeconds, fJson);
+
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include "image.hpp"
+#include "ihex.hpp"
+#include <stdio.h>
+#include <string.h>
+
+static bool store_data(void* pvContext, uint32 ea, const uint8* pbData, size_t cbData)
+{
+    rom_image& image = *(rom_image*)pvContext;
+
+    if (ea + cbData > image.vbROM.size())
+        return false;
+
+    memcpy(&image.vbROM[ea], pbData, cbData);
+    if (ea + cbData > image.cbUsed) image.cbUsed = ea + cbData;
+    return true;
+}
+
+static bool load_hex(FILE* fp, rom_image& image, std::string& strError)
+{
+    ihex_parser parser;
+    char rgch[4096];
+    size_t cch;
+    int status = ihex_ok;
+
+    ihex_init(&parser, store_data, &image);
+    while (status == ihex_ok && (cch = fread(rgch, 1, sizeof(rgch), fp)) > 0)
+        status = ihex_feed(&parser, rgch, cch);
+    status = ihex_finish(&parser);
+
+    if (status != ihex_ok)
+    {
+        strError = image.strName + ":" + std::to_string(parser.nLine) + ": " +
+            (status == ihex_aborted ? "address beyond the ROM" : ihex_strerror(status));
+        return false;
+    }
+
+    return true;
+}
+
+// Load an Intel HEX file (*.hex) or a raw binary
+bool load_image(const char* szPath, rom_image& image, std::string& strError)
+{
+    const char* szExt = strrchr(szPath, '.');
+    const char* szName = strrchr(szPath, '/');
+    FILE* fp;
+    bool fOk = true;
+
+    image.strName = szName ? szName + 1 : szPath;
+    image.vbROM.assign(ROM_SIZE_MAX, 0xFF);
+    image.cbUsed = 0;
+
+    fp = fopen(szPath, "rb");
+    if (!fp)
+    {
+        strError = std::string("can not open ") + szPath;
+        return false;
+    }
+
+    if (szExt && !strcmp(szExt, ".hex"))
+        fOk = load_hex(fp, image, strError);
+    else
+        image.cbUsed = fread(&image.vbROM[0], 1, image.vbROM.size(), fp);
+
+    fclose(fp);
+    return fOk;
+}
+
+// Fill a ROM with a random stream of valid instructions. Branch targets stay
+// inside the ROM so the image looks like real code to every pass.
+void synth_image(uint32 dwSeed, size_t cbROM, rom_image& image)
+{
+    uint32 x = dwSeed ? dwSeed : 1;
+    size_t ea = 0;
+    uint8 code;
+
+    image.strName = "synth-" + std::to_string(cbROM / 1024) + "k-" + std::to_string(dwSeed);
+    image.vbROM.assign(cbROM, 0xFF);
+    image.cbUsed = cbROM;
+
+    while (ea < cbROM)
+    {
+        do
+        {
+            x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+            code = (uint8)x;
+        }
+        while (rgOpcodes[code].itype == M8B_null);
+
+        if (ea + rgOpcodes[code].size > cbROM)
+            code = 0x20;                // NOP
+
+        if (rgOpcodes[code].op1 == opk_near || rgOpcodes[code].op1 == opk_near1)
+            code = (uint8)((code & 0xF0) | ((x >> 8) % (cbROM >> 8) & 0xF));
+
+        image.vbROM[ea++] = code;
+        if (rgOpcodes[code].size > 1)
+            image.vbROM[ea++] = (uint8)(x >> 16);
+    }
+}
+
+// The vectors of a ROM of cbROM bytes, as roots for m8b_descend()
+size_t get_vector_roots(size_t cbROM, uint16 rgeaRoots[VECTOR_ROOTS])
+{
+    size_t ea, nRoots = 0;
+
+    for (ea = 0; ea < VECTOR_END && ea < cbROM; ea += 2)
+        rgeaRoots[nRoots++] = (uint16)ea;
+    return nRoots;
+}
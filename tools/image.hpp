@@ -0,0 +1,25 @@
+#ifndef IMAGE_HPP_INCLUDED
+#define IMAGE_HPP_INCLUDED
+
+#include "dec.hpp"
+#include <string>
+#include <vector>
+
+#define ROM_SIZE_MAX 0x2000
+#define VECTOR_END   0x18       // CY7C63723 RESET .. WAKEUP, one JMP every two bytes
+#define VECTOR_ROOTS (VECTOR_END / 2)
+
+// A ROM image as the tools see it: the bytes and how much of them is used.
+typedef struct rom_image_t
+{
+    std::string strName;
+    std::vector<uint8> vbROM;
+    size_t cbUsed;
+}
+rom_image;
+
+bool load_image(const char* szPath, rom_image& image, std::string& strError);
+void synth_image(uint32 dwSeed, size_t cbROM, rom_image& image);
+size_t get_vector_roots(size_t cbROM, uint16 rgeaRoots[VECTOR_ROOTS]);
+
+#endif
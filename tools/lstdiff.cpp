@@ -0,0 +1,530 @@
+// Differential check of the decoder against cyasm listings. Every instruction
+// line of a listing is decoded from the matching HEX image and compared with
+// what cyasm printed: bytes, size, mnemonic, cycle count and each operand's
+// shape ([expr], [X+expr], register, plain value) and value.
+//
+// usage: m8blstdiff [-q] [listing.lst image.hex ...]
+//   -q  only print the summary
+// Without arguments the bundled examples are checked.
+
+#include "image.hpp"
+#include <chrono>
+#include <ctype.h>
+#include <map>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+struct nocase_less
+{
+    bool operator()(const std::string& a, const std::string& b) const { return strcasecmp(a.c_str(), b.c_str()) < 0; }
+};
+
+// cyasm symbols are case sensitive, but the examples also reference labels
+// with a different case ("jmp error" for "Error:"), so fall back to that
+typedef struct symbol_map_t
+{
+    std::map<std::string, long> mapExact;
+    std::map<std::string, long, nocase_less> mapNoCase;
+}
+symbol_map;
+
+typedef struct lst_insn_t
+{
+    size_t nLine;
+    uint32 ea;
+    uint8 rgbyCode[2];
+    size_t cbCode;
+    unsigned nCycles;
+    std::string strMnem;
+    std::string rgstrOps[2];
+    size_t nOps;
+}
+lst_insn;
+
+enum opshape_t { osNone = 0, osReg, osValue, osMem, osDispl };
+
+typedef struct operand_t
+{
+    int shape;
+    std::string strReg;
+    long value;
+    bool fKnown;
+}
+operand;
+
+typedef struct diff_stats_t
+{
+    size_t nInsns;
+    size_t nMismatches;
+    double dSeconds;
+}
+diff_stats;
+
+static bool fQuiet;
+
+static std::string trim(const std::string& str)
+{
+    size_t i = str.find_first_not_of(" \t"), j = str.find_last_not_of(" \t");
+    return i == std::string::npos ? std::string() : str.substr(i, j - i + 1);
+}
+
+static bool is_ident_char(char c)
+{
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+//-----------------------------------------------------------------------
+//      Expressions
+//-----------------------------------------------------------------------
+typedef struct expr_ctx_t
+{
+    const symbol_map* pSymbols;
+    const char* pch;
+    bool fOk;
+}
+expr_ctx;
+
+static long parse_or(expr_ctx& ctx);
+
+static void skip_blanks(expr_ctx& ctx)
+{
+    while (*ctx.pch == ' ' || *ctx.pch == '\t') ++ctx.pch;
+}
+
+static long parse_atom(expr_ctx& ctx)
+{
+    std::string strToken;
+    std::map<std::string, long>::const_iterator it;
+    std::map<std::string, long, nocase_less>::const_iterator itNoCase;
+    const char* pch;
+    char* pchEnd;
+    long value;
+
+    skip_blanks(ctx);
+
+    switch (*ctx.pch)
+    {
+    case '(':
+        ++ctx.pch;
+        value = parse_or(ctx);
+        skip_blanks(ctx);
+        if (*ctx.pch == ')') ++ctx.pch; else ctx.fOk = false;
+        return value;
+    case '-':
+        ++ctx.pch;
+        return -parse_atom(ctx);
+    case '~':
+        ++ctx.pch;
+        return ~parse_atom(ctx);
+    }
+
+    for (pch = ctx.pch; is_ident_char(*pch); ++pch);
+    strToken.assign(ctx.pch, pch);
+    ctx.pch = pch;
+
+    if (strToken.empty())
+    {
+        ctx.fOk = false;
+        return 0;
+    }
+
+    it = ctx.pSymbols->mapExact.find(strToken);
+    if (it != ctx.pSymbols->mapExact.end())
+        return it->second;
+    itNoCase = ctx.pSymbols->mapNoCase.find(strToken);
+    if (itNoCase != ctx.pSymbols->mapNoCase.end())
+        return itNoCase->second;
+
+    if (strToken.size() > 1 && tolower(strToken.back()) == 'h')
+    {
+        value = strtol(strToken.c_str(), &pchEnd, 16);
+        if (pchEnd == strToken.c_str() + strToken.size() - 1) return value;
+    }
+    if (strToken.size() > 1 && tolower(strToken.back()) == 'b')
+    {
+        value = strtol(strToken.c_str(), &pchEnd, 2);
+        if (pchEnd == strToken.c_str() + strToken.size() - 1) return value;
+    }
+    value = strtol(strToken.c_str(), &pchEnd, 10);
+    if (*pchEnd) ctx.fOk = false;
+    return value;
+}
+
+static long parse_mul(expr_ctx& ctx)
+{
+    long value = parse_atom(ctx);
+
+    for (;;)
+    {
+        skip_blanks(ctx);
+        if (*ctx.pch == '*') { ++ctx.pch; value *= parse_atom(ctx); }
+        else if (ctx.pch[0] == '<' && ctx.pch[1] == '<') { ctx.pch += 2; value <<= parse_atom(ctx); }
+        else if (ctx.pch[0] == '>' && ctx.pch[1] == '>') { ctx.pch += 2; value >>= parse_atom(ctx); }
+        else return value;
+    }
+}
+
+static long parse_add(expr_ctx& ctx)
+{
+    long value = parse_mul(ctx);
+
+    for (;;)
+    {
+        skip_blanks(ctx);
+        if (*ctx.pch == '+') { ++ctx.pch; value += parse_mul(ctx); }
+        else if (*ctx.pch == '-') { ++ctx.pch; value -= parse_mul(ctx); }
+        else return value;
+    }
+}
+
+static long parse_or(expr_ctx& ctx)
+{
+    long value = parse_add(ctx);
+
+    for (;;)
+    {
+        skip_blanks(ctx);
+        if (*ctx.pch == '|') { ++ctx.pch; value |= parse_add(ctx); }
+        else if (*ctx.pch == '&') { ++ctx.pch; value &= parse_add(ctx); }
+        else if (*ctx.pch == '^') { ++ctx.pch; value ^= parse_add(ctx); }
+        else return value;
+    }
+}
+
+static bool eval_expr(const symbol_map& symbols, const std::string& strExpr, long& value)
+{
+    expr_ctx ctx;
+
+    ctx.pSymbols = &symbols;
+    ctx.pch = strExpr.c_str();
+    ctx.fOk = true;
+    value = parse_or(ctx);
+    skip_blanks(ctx);
+
+    return ctx.fOk && !*ctx.pch;
+}
+
+// Classify an operand as cyasm or m8b_render_operand() print it
+static operand classify_operand(const symbol_map& symbols, const std::string& strText)
+{
+    static const char* rgszRegs[] = { "A", "X", "DSP", "PSP" };
+    std::string str = trim(strText), strInner;
+    operand op;
+    size_t i;
+
+    op.shape = osNone;
+    op.value = 0;
+    op.fKnown = false;
+    if (str.empty()) return op;
+
+    for (i = 0; i < sizeof(rgszRegs) / sizeof(rgszRegs[0]); ++i)
+    {
+        if (!strcasecmp(str.c_str(), rgszRegs[i]))
+        {
+            op.shape = osReg;
+            op.strReg = rgszRegs[i];
+            op.fKnown = true;
+            return op;
+        }
+    }
+
+    if (str[0] == '[' && str[str.size() - 1] == ']')
+    {
+        strInner = trim(str.substr(1, str.size() - 2));
+        op.shape = osMem;
+        if (strInner.size() > 1 && toupper(strInner[0]) == 'X' && !is_ident_char(strInner[1]))
+        {
+            strInner = trim(strInner.substr(1));
+            if (strInner[0] == '+') strInner = strInner.substr(1);
+            op.shape = osDispl;
+        }
+        op.fKnown = eval_expr(symbols, strInner, op.value);
+        return op;
+    }
+
+    op.shape = osValue;
+    op.fKnown = eval_expr(symbols, str, op.value);
+    return op;
+}
+
+//-----------------------------------------------------------------------
+//      Listings
+//-----------------------------------------------------------------------
+
+// Split "label: mnemonic op1, op2 ; comment" into its parts
+static void split_source(const std::string& strSource, std::string& strLabel, lst_insn& insn)
+{
+    std::string str = strSource;
+    size_t i, nDepth;
+
+    i = str.find(';');
+    if (i != std::string::npos) str.erase(i);
+    str = trim(str);
+
+    for (i = 0; i < str.size() && is_ident_char(str[i]); ++i);
+    if (i && i < str.size() && str[i] == ':')
+    {
+        strLabel = str.substr(0, i);
+        str = trim(str.substr(i + 1));
+    }
+
+    for (i = 0; i < str.size() && is_ident_char(str[i]); ++i);
+    insn.strMnem = str.substr(0, i);
+    str = trim(str.substr(i));
+
+    insn.nOps = 0;
+    if (str.empty()) return;
+
+    for (i = 0, nDepth = 0; i < str.size(); ++i)
+    {
+        if (str[i] == '(' || str[i] == '[') ++nDepth;
+        else if ((str[i] == ')' || str[i] == ']') && nDepth) --nDepth;
+        else if (str[i] == ',' && !nDepth && insn.nOps == 0)
+        {
+            insn.rgstrOps[insn.nOps++] = trim(str.substr(0, i));
+            str = str.substr(i + 1);
+            i = (size_t)-1;
+        }
+    }
+
+    if (insn.nOps < 2) insn.rgstrOps[insn.nOps++] = trim(str);
+}
+
+static void add_symbol(symbol_map& symbols, const std::string& strName, long value)
+{
+    if (strName.empty()) return;
+    symbols.mapExact[strName] = value;
+    symbols.mapNoCase[strName] = value;
+}
+
+static bool read_listing(const char* szPath, symbol_map& symbols, std::vector<lst_insn>& vInsns)
+{
+    char szLine[1024];
+    std::string strLine, strLabel;
+    lst_insn insn;
+    unsigned ea, rgb[2], nCycles;
+    size_t nLine = 0, cch;
+    FILE* fp;
+    int n;
+
+    fp = fopen(szPath, "rb");
+    if (!fp) return false;
+
+    while (fgets(szLine, sizeof(szLine), fp))
+    {
+        ++nLine;
+        strLine = szLine;
+        while (!strLine.empty() && (strLine.back() == '\n' || strLine.back() == '\r')) strLine.pop_back();
+
+        if (strLine.size() < 5 || sscanf(strLine.c_str(), "%4x", &ea) != 1 || !isxdigit((unsigned char)strLine[3]))
+            continue;
+
+        // "00E8=   name:   equ  value"
+        if (strLine[4] == '=')
+        {
+            split_source(strLine.substr(5), strLabel = "", insn);
+            add_symbol(symbols, strLabel, ea);
+            continue;
+        }
+
+        // "AAAA BB CC [nn] source" or "AAAA BB    [nn] source"
+        n = sscanf(strLine.c_str(), "%4x %2x %2x [%u]%zn", &ea, &rgb[0], &rgb[1], &nCycles, &cch);
+        if (n == 4)
+            insn.cbCode = 2;
+        else if ((n = sscanf(strLine.c_str(), "%4x %2x [%u]%zn", &ea, &rgb[0], &nCycles, &cch)) == 3)
+            insn.cbCode = 1;
+        else
+        {
+            // "AAAA    label:"
+            strLabel.clear();
+            split_source(strLine.substr(4), strLabel, insn);
+            add_symbol(symbols, strLabel, ea);
+            continue;
+        }
+
+        strLabel.clear();
+        split_source(strLine.substr(cch), strLabel, insn);
+        add_symbol(symbols, strLabel, ea);
+
+        if (insn.strMnem.empty() || !strcasecmp(insn.strMnem.c_str(), "db") || !strcasecmp(insn.strMnem.c_str(), "dw") || !strcasecmp(insn.strMnem.c_str(), "ds"))
+            continue;
+
+        insn.nLine = nLine;
+        insn.ea = ea;
+        insn.rgbyCode[0] = (uint8)rgb[0];
+        insn.rgbyCode[1] = (uint8)rgb[1];
+        insn.nCycles = nCycles;
+        vInsns.push_back(insn);
+    }
+
+    fclose(fp);
+    return true;
+}
+
+//-----------------------------------------------------------------------
+//      Comparison
+//-----------------------------------------------------------------------
+static void report(const char* szListing, const lst_insn& insn, const char* szRendered, const char* szFormat, ...)
+{
+    va_list va;
+
+    if (fQuiet) return;
+
+    printf("%s:%zu: %04X: ", szListing, insn.nLine, insn.ea);
+    va_start(va, szFormat);
+    vprintf(szFormat, va);
+    va_end(va);
+    printf(" (cyasm: %s %s%s%s, m8b: %s)\n", insn.strMnem.c_str(), insn.rgstrOps[0].c_str(),
+           insn.nOps > 1 ? ", " : "", insn.nOps > 1 ? insn.rgstrOps[1].c_str() : "", szRendered);
+}
+
+static bool compare_insn(const char* szListing, const symbol_map& symbols, const lst_insn& insn, const m8b_insn& decoded)
+{
+    char szRendered[64], szOperand[32];
+    operand opLst, opM8b;
+    size_t i, nOps;
+    long mask;
+
+    m8b_render(&decoded, szRendered, sizeof(szRendered));
+
+    if (!decoded.size)
+    {
+        report(szListing, insn, szRendered, "invalid opcode %02Xh", decoded.code);
+        return false;
+    }
+    if (decoded.size != insn.cbCode || decoded.code != insn.rgbyCode[0] || (insn.cbCode > 1 && decoded.value != insn.rgbyCode[1]))
+    {
+        report(szListing, insn, szRendered, "image bytes differ from the listing");
+        return false;
+    }
+    if (strcasecmp(rgInstructions[decoded.itype].name, insn.strMnem.c_str()))
+    {
+        report(szListing, insn, szRendered, "mnemonic differs");
+        return false;
+    }
+    if (rgOpcodes[decoded.code].cycles != insn.nCycles)
+    {
+        report(szListing, insn, szRendered, "%u cycles, cyasm says %u", rgOpcodes[decoded.code].cycles, insn.nCycles);
+        return false;
+    }
+
+    for (nOps = 0; nOps < 2 && m8b_render_operand(&decoded, nOps, szOperand, sizeof(szOperand)); ++nOps);
+    if (nOps != insn.nOps)
+    {
+        report(szListing, insn, szRendered, "%zu operands, cyasm has %zu", nOps, insn.nOps);
+        return false;
+    }
+
+    for (i = 0; i < nOps; ++i)
+    {
+        m8b_render_operand(&decoded, i, szOperand, sizeof(szOperand));
+        opM8b = classify_operand(symbols, szOperand);
+        opLst = classify_operand(symbols, insn.rgstrOps[i]);
+
+        if (opLst.shape != opM8b.shape || opLst.strReg != opM8b.strReg)
+        {
+            report(szListing, insn, szRendered, "operand %zu is printed differently", i + 1);
+            return false;
+        }
+
+        // cyasm truncates byte operands, so compare the bits that were encoded
+        mask = rgOpcodes[decoded.code].op1 == opk_near || rgOpcodes[decoded.code].op1 == opk_near1 ? 0x1FFF : 0xFF;
+        if (opLst.fKnown && opM8b.fKnown && ((opLst.value ^ opM8b.value) & mask))
+        {
+            report(szListing, insn, szRendered, "operand %zu is %lXh, cyasm has %lXh", i + 1, opM8b.value & mask, opLst.value & mask);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool diff_listing(const char* szListing, const char* szImage, diff_stats& stats)
+{
+    typedef std::chrono::steady_clock clock;
+    std::vector<lst_insn> vInsns;
+    std::vector<m8b_insn> vDecoded;
+    std::string strError;
+    symbol_map symbols;
+    rom_image image;
+    m8b_decoder decoder;
+    clock::time_point tStart;
+    size_t i;
+
+    if (!read_listing(szListing, symbols, vInsns))
+    {
+        fprintf(stderr, "can not read %s\n", szListing);
+        return false;
+    }
+    if (!load_image(szImage, image, strError))
+    {
+        fprintf(stderr, "%s\n", strError.c_str());
+        return false;
+    }
+
+    m8b_init(&decoder, &image.vbROM[0], image.vbROM.size());
+    vDecoded.resize(vInsns.size());
+
+    tStart = clock::now();
+    for (i = 0; i < vInsns.size(); ++i)
+        m8b_decode(&decoder, vInsns[i].ea, &vDecoded[i]);
+    stats.dSeconds += std::chrono::duration<double>(clock::now() - tStart).count();
+
+    for (i = 0; i < vInsns.size(); ++i)
+    {
+        if (!compare_insn(szListing, symbols, vInsns[i], vDecoded[i]))
+            ++stats.nMismatches;
+    }
+    stats.nInsns += vInsns.size();
+
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    static const char* rgszDefaults[] =
+    {
+        "../examples/logo.lst", "../examples/logo.hex",
+        "../examples/mouse.lst", "../examples/mouse.hex"
+    };
+    typedef std::chrono::steady_clock clock;
+    const char** rgszArgs;
+    diff_stats stats = { 0, 0, 0 };
+    clock::time_point tStart;
+    double dTotal;
+    int c, nArgs;
+
+    for (c = 1; c < argc && argv[c][0] == '-'; ++c)
+    {
+        if (!strcmp(argv[c], "-q"))
+            fQuiet = true;
+        else
+        {
+            fprintf(stderr, "usage: %s [-q] [listing.lst image.hex ...]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    rgszArgs = c < argc ? (const char**)argv + c : rgszDefaults;
+    nArgs = c < argc ? argc - c : (int)(sizeof(rgszDefaults) / sizeof(rgszDefaults[0]));
+    if (nArgs % 2)
+    {
+        fprintf(stderr, "listing and image have to be given in pairs\n");
+        return 2;
+    }
+
+    tStart = clock::now();
+    for (c = 0; c < nArgs; c += 2)
+    {
+        if (!diff_listing(rgszArgs[c], rgszArgs[c + 1], stats))
+            return 1;
+    }
+    dTotal = std::chrono::duration<double>(clock::now() - tStart).count();
+
+    printf("%zu instructions, %zu mismatches, decode %.1f ns/insn, total %.3f ms\n",
+           stats.nInsns, stats.nMismatches, stats.nInsns ? stats.dSeconds * 1e9 / stats.nInsns : 0.0, dTotal * 1e3);
+
+    return stats.nMismatches ? 1 : 0;
+}
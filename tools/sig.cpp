@@ -0,0 +1,293 @@
+// Builds a function fingerprint index (../m8b/sig.hpp) from images with their
+// cyasm listings, or names the known routines of other images with one. The
+// routines are the call and jump targets and interrupt handlers a recursive
+// descent from the CY7C63723 vectors finds (the USB framework is mostly jumped
+// to); their names come from the listing labels.
+//
+// usage: m8bsig -b index.sig [image.hex listing.lst ...]
+//        m8bsig index.sig [image.hex ...]
+//   -b  build the index
+// Without images the bundled examples are used.
+
+#include "image.hpp"
+#include "sig.hpp"
+#include <algorithm>
+#include <ctype.h>
+#include <map>
+#include <stdio.h>
+#include <string.h>
+
+typedef struct named_sig_t
+{
+    m8b_sig sig;
+    std::string strName;
+}
+named_sig;
+
+static bool named_less(const named_sig& a, const named_sig& b)
+{
+    if (m8b_sig_less(a.sig, b.sig)) return true;
+    if (m8b_sig_less(b.sig, a.sig)) return false;
+    return a.strName < b.strName;
+}
+
+static bool same_sig(const m8b_sig& a, const m8b_sig& b)
+{
+    return !m8b_sig_less(a, b) && !m8b_sig_less(b, a);
+}
+
+// Call and jump targets, and where the vectors jump to
+static void find_functions(const m8b_decoder* pDecoder, std::vector<uint16>& vFunctions)
+{
+    std::vector<uint8> vbFlags(pDecoder->cbROM + 1);
+    std::vector<uint16> vWork(pDecoder->cbROM + 1);
+    uint16 rgeaRoots[VECTOR_ROOTS];
+    m8b_insn insn;
+    size_t nRoots, ea;
+
+    nRoots = get_vector_roots(pDecoder->cbROM, rgeaRoots);
+    m8b_descend(pDecoder, rgeaRoots, nRoots, &vbFlags[0], &vWork[0], NULL, NULL);
+
+    for (ea = 0; ea < nRoots * 2; ea += 2)
+        if (m8b_decode(pDecoder, ea, &insn) && insn.itype == M8B_JMP && insn.addr < pDecoder->cbROM)
+            vbFlags[insn.addr] |= M8B_DF_CALL;
+
+    vFunctions.clear();
+    for (ea = 0; ea < pDecoder->cbROM; ++ea)
+        if ((vbFlags[ea] & M8B_DF_CODE) && (vbFlags[ea] & (M8B_DF_CALL | M8B_DF_JUMP | M8B_DF_CASE)))
+            vFunctions.push_back((uint16)ea);
+}
+
+// Code labels of a cyasm listing: "AAAA    label:" or "AAAA BB CC [nn] label: ..."
+static bool read_labels(const char* szPath, std::map<uint16, std::string>& mapLabels)
+{
+    char szLine[1024];
+    unsigned ea, rgb[2], nCycles;
+    const char* pch;
+    size_t cch;
+    FILE* fp;
+
+    fp = fopen(szPath, "rb");
+    if (!fp) return false;
+
+    while (fgets(szLine, sizeof(szLine), fp))
+    {
+        if (sscanf(szLine, "%4x", &ea) != 1 || !isxdigit((unsigned char)szLine[3]) || szLine[4] == '=')
+            continue;
+
+        if (sscanf(szLine, "%4x %2x %2x [%u]%zn", &ea, &rgb[0], &rgb[1], &nCycles, &cch) == 4 ||
+            sscanf(szLine, "%4x %2x [%u]%zn", &ea, &rgb[0], &nCycles, &cch) == 3)
+            pch = szLine + cch;
+        else
+            pch = szLine + 4;
+
+        while (*pch == ' ' || *pch == '\t') ++pch;
+        for (cch = 0; isalnum((unsigned char)pch[cch]) || pch[cch] == '_'; ++cch);
+        if (cch && pch[cch] == ':' && !mapLabels.count((uint16)ea))
+            mapLabels[(uint16)ea] = std::string(pch, cch);
+    }
+
+    fclose(fp);
+    return true;
+}
+
+static bool add_image(const char* szImage, const char* szListing, std::vector<named_sig>& vSigs)
+{
+    std::map<uint16, std::string> mapLabels;
+    std::map<uint16, std::string>::const_iterator it;
+    std::vector<uint16> vFunctions;
+    std::string strError;
+    m8b_decoder decoder;
+    rom_image image;
+    named_sig named;
+    size_t i, nAdded = 0;
+
+    if (!load_image(szImage, image, strError))
+    {
+        fprintf(stderr, "%s\n", strError.c_str());
+        return false;
+    }
+    if (!read_labels(szListing, mapLabels))
+    {
+        fprintf(stderr, "can not open %s\n", szListing);
+        return false;
+    }
+
+    m8b_init(&decoder, &image.vbROM[0], image.cbUsed);
+    find_functions(&decoder, vFunctions);
+    for (i = 0; i < vFunctions.size(); ++i)
+    {
+        it = mapLabels.find(vFunctions[i]);
+        if (it == mapLabels.end() || !m8b_sig_hash(&decoder, vFunctions[i], &named.sig)) continue;
+        named.strName = it->second;
+        vSigs.push_back(named);
+        ++nAdded;
+    }
+
+    printf("%s: %zu functions, %zu fingerprinted\n", image.strName.c_str(), vFunctions.size(), nAdded);
+    return true;
+}
+
+// Sorted, without duplicates; a fingerprint that stands for different names
+// is left out altogether
+static bool build_index(const char* szIndex, char** rgszArgs, int nArgs)
+{
+    static const char* rgszDefaults[] = { "../examples/logo.hex", "../examples/logo.lst", "../examples/mouse.hex", "../examples/mouse.lst" };
+    std::vector<named_sig> vSigs;
+    std::vector<m8b_sig> vIndex;
+    std::string strNames;
+    m8b_sig_header header;
+    size_t i, j, nAmbiguous = 0;
+    bool fOk = true;
+    FILE* fp;
+
+    if (!nArgs)
+    {
+        rgszArgs = (char**)rgszDefaults;
+        nArgs = (int)(sizeof(rgszDefaults) / sizeof(rgszDefaults[0]));
+    }
+    if (nArgs % 2)
+    {
+        fprintf(stderr, "every image needs its listing\n");
+        return false;
+    }
+
+    for (i = 0; i < (size_t)nArgs; i += 2)
+        fOk &= add_image(rgszArgs[i], rgszArgs[i + 1], vSigs);
+
+    std::sort(vSigs.begin(), vSigs.end(), named_less);
+    for (i = 0; i < vSigs.size(); i = j)
+    {
+        for (j = i + 1; j < vSigs.size() && same_sig(vSigs[i].sig, vSigs[j].sig); ++j)
+            if (vSigs[j].strName != vSigs[i].strName) break;
+
+        if (j < vSigs.size() && same_sig(vSigs[i].sig, vSigs[j].sig))
+        {
+            for (; j < vSigs.size() && same_sig(vSigs[i].sig, vSigs[j].sig); ++j);
+            ++nAmbiguous;
+            continue;
+        }
+
+        vSigs[i].sig.offName = (uint32)strNames.size();
+        strNames.append(vSigs[i].strName.c_str(), vSigs[i].strName.size() + 1);
+        vIndex.push_back(vSigs[i].sig);
+    }
+
+    if (vIndex.size() > M8B_SIG_MAXSIGS)
+    {
+        fprintf(stderr, "%zu routines, an index holds %u\n", vIndex.size(), M8B_SIG_MAXSIGS);
+        return false;
+    }
+
+    header.dwMagic = M8B_SIG_MAGIC;
+    header.dwVersion = M8B_SIG_VERSION;
+    header.nSigs = (uint32)vIndex.size();
+    header.cbNames = (uint32)strNames.size();
+
+    fp = fopen(szIndex, "wb");
+    if (!fp ||
+        fwrite(&header, sizeof(header), 1, fp) != 1 ||
+        (vIndex.size() && fwrite(&vIndex[0], sizeof(m8b_sig), vIndex.size(), fp) != vIndex.size()) ||
+        fwrite(strNames.data(), 1, strNames.size(), fp) != strNames.size())
+        fOk = false;
+    if (fp && fclose(fp)) fOk = false;
+    if (!fOk)
+    {
+        fprintf(stderr, "can not write %s\n", szIndex);
+        return false;
+    }
+
+    printf("%s: %zu routines, %zu ambiguous left out, %zu bytes\n", szIndex, vIndex.size(), nAmbiguous,
+           sizeof(header) + vIndex.size() * sizeof(m8b_sig) + strNames.size());
+    return fOk;
+}
+
+static bool load_index(const char* szIndex, std::vector<uint32>& vdwFile, m8b_sig_index* pIndex)
+{
+    long cbFile;
+    FILE* fp;
+
+    fp = fopen(szIndex, "rb");
+    if (!fp)
+    {
+        fprintf(stderr, "can not open %s\n", szIndex);
+        return false;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    cbFile = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    // uint32 words keep the records aligned
+    vdwFile.resize(cbFile / sizeof(uint32) + 1);
+    if (cbFile < 0 || fread(&vdwFile[0], 1, cbFile, fp) != (size_t)cbFile || !m8b_sig_open(pIndex, &vdwFile[0], cbFile))
+    {
+        fclose(fp);
+        fprintf(stderr, "%s is not a fingerprint index\n", szIndex);
+        return false;
+    }
+
+    fclose(fp);
+    return true;
+}
+
+static bool match_image(const m8b_sig_index* pIndex, const char* szImage)
+{
+    std::vector<uint16> vFunctions;
+    std::string strError;
+    m8b_decoder decoder;
+    rom_image image;
+    const char* szName;
+    size_t i, nNamed = 0;
+
+    if (!load_image(szImage, image, strError))
+    {
+        fprintf(stderr, "%s\n", strError.c_str());
+        return false;
+    }
+
+    m8b_init(&decoder, &image.vbROM[0], image.cbUsed);
+    find_functions(&decoder, vFunctions);
+    for (i = 0; i < vFunctions.size(); ++i)
+    {
+        szName = m8b_sig_match(pIndex, &decoder, vFunctions[i]);
+        if (!szName) continue;
+        printf("  %04X  %s\n", vFunctions[i], szName);
+        ++nNamed;
+    }
+
+    printf("%s: %zu of %zu functions named\n", image.strName.c_str(), nNamed, vFunctions.size());
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    static const char* rgszDefaults[] = { "../examples/logo.hex", "../examples/mouse.hex" };
+    std::vector<uint32> vdwFile;
+    m8b_sig_index index;
+    bool fOk = true;
+    int c;
+
+    if (argc > 2 && !strcmp(argv[1], "-b"))
+        return build_index(argv[2], argv + 3, argc - 3) ? 0 : 1;
+
+    if (argc < 2 || argv[1][0] == '-')
+    {
+        fprintf(stderr, "usage: %s -b index.sig [image.hex listing.lst ...]\n"
+                        "       %s index.sig [image.hex ...]\n", argv[0], argv[0]);
+        return 2;
+    }
+
+    if (!load_index(argv[1], vdwFile, &index))
+        return 1;
+
+    if (argc == 2)
+    {
+        for (c = 0; c < (int)(sizeof(rgszDefaults) / sizeof(rgszDefaults[0])); ++c)
+            fOk &= match_image(&index, rgszDefaults[c]);
+    }
+    for (c = 2; c < argc; ++c)
+        fOk &= match_image(&index, argv[c]);
+
+    return fOk ? 0 : 1;
+}
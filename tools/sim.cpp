@@ -0,0 +1,235 @@
+// Runs a firmware image on the predecoded simulator in ../m8b/sim.cpp with the
+// CY7C63723 timers attached (see m8b.cfg): the 128us and 1.024ms interrupts
+// and the free-running microsecond timer. Everything else reads back as the
+// firmware last wrote it. The RAM size is that of the default device in the
+// cfg; the timer ports and vectors are the CY7C63723's.
+//
+// usage: m8bsim [-v] [-m ms] [-c m8b.cfg] [image.hex ...]
+//   -v  trace I/O writes
+//   -m  simulated time per image in milliseconds (default 100)
+//   -c  device description (default ../m8b/m8b.cfg)
+// Without images the bundled examples are run.
+
+#include "image.hpp"
+#include "sim.hpp"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CPU_HZ          12000000
+#define CFG_FILE        "../m8b/m8b.cfg"
+
+// CY7C63723 vectors and registers, as in m8b.cfg
+#define VEC_TIMER_128US 0x0004
+#define VEC_TIMER_1MS   0x0006
+#define PORT_GLOBAL_INT 0x20
+#define PORT_TIMER_LSB  0x24
+#define PORT_TIMER_MSB  0x25
+#define INT_1MS         0x04
+#define INT_128US       0x02
+
+#define CYCLES_128US    (CPU_HZ / 1000000 * 128)
+#define CYCLES_1MS      (CPU_HZ / 1000000 * 1024)
+
+typedef struct sim_host_t
+{
+    m8b_sim* pSim;
+    uint8 bTimerMsb;    // latched when timer_lsb is read
+    bool fTrace;
+    size_t nWrites;
+}
+sim_host;
+
+static uint8 host_read(void* pvContext, uint8 port)
+{
+    sim_host* pHost = (sim_host*)pvContext;
+    uint32 dwMicros = (uint32)(pHost->pSim->qwCycles / (CPU_HZ / 1000000));
+
+    switch (port)
+    {
+    case PORT_TIMER_LSB:
+        pHost->bTimerMsb = (uint8)((dwMicros >> 8) & 0x0F);
+        return (uint8)dwMicros;
+    case PORT_TIMER_MSB:
+        return pHost->bTimerMsb;
+    }
+    return pHost->pSim->rgbIO[port];
+}
+
+static void host_write(void* pvContext, uint8 port, uint8 value)
+{
+    sim_host* pHost = (sim_host*)pvContext;
+
+    ++pHost->nWrites;
+    if (pHost->fTrace)
+        printf("  %10llu  %04X  IOWR %02Xh <- %02Xh\n", (unsigned long long)pHost->pSim->qwCycles, pHost->pSim->pc, port, value);
+}
+
+// RAM of the .default device: its "area DATA name start:end" line
+static bool read_ram_size(const char* szCfg, size_t* pcbRAM)
+{
+    char szLine[512], szDevice[64] = "", szSection[64] = "";
+    unsigned start, end;
+    bool fFound = false;
+    FILE* fp;
+
+    fp = fopen(szCfg, "rb");
+    if (!fp)
+    {
+        fprintf(stderr, "can not open %s\n", szCfg);
+        return false;
+    }
+
+    while (!fFound && fgets(szLine, sizeof(szLine), fp))
+    {
+        if (sscanf(szLine, ".default %63s", szDevice) == 1)
+            continue;
+        if (szLine[0] == '.')
+            sscanf(szLine, ".%63s", szSection);
+        else if (szDevice[0] && !strcmp(szSection, szDevice) && sscanf(szLine, "area DATA %*s %x:%x", &start, &end) == 2 && end > start)
+        {
+            *pcbRAM = end - start;
+            fFound = true;
+        }
+    }
+
+    fclose(fp);
+    if (!fFound)
+        fprintf(stderr, "%s: no RAM area for the default device\n", szCfg);
+    return fFound;
+}
+
+static const char* stop_name(int stop)
+{
+    switch (stop)
+    {
+    case m8b_sim_budget: return "budget";
+    case m8b_sim_halted: return "halted";
+    case m8b_sim_badop:  return "bad opcode";
+    }
+    return "?";
+}
+
+static bool run_image(const char* szPath, size_t cbRAM, uint64 qwBudget, bool fTrace)
+{
+    typedef std::chrono::steady_clock clock;
+    rom_image image;
+    std::string strError;
+    std::vector<m8b_simop> vOps;
+    m8b_sim sim;
+    sim_host host;
+    clock::time_point tStart;
+    uint64 qwNext128us = CYCLES_128US, qwNext1ms = CYCLES_1MS, qwUntil;
+    uint8 bPending = 0, bEnabled;
+    size_t nInterrupts = 0;
+    double dSeconds;
+    int stop;
+
+    if (!load_image(szPath, image, strError))
+    {
+        fprintf(stderr, "%s\n", strError.c_str());
+        return false;
+    }
+
+    tStart = clock::now();
+    vOps.resize(image.cbUsed + 1);
+    m8b_sim_predecode(&image.vbROM[0], image.cbUsed, &vOps[0]);
+    if (!m8b_sim_init(&sim, &image.vbROM[0], image.cbUsed, cbRAM, &vOps[0]))
+    {
+        fprintf(stderr, "%zu bytes of RAM can not be simulated, a power of two up to 256 can\n", cbRAM);
+        return false;
+    }
+
+    memset(&host, 0, sizeof(host));
+    host.pSim = &sim;
+    host.fTrace = fTrace;
+    sim.pfnRead = host_read;
+    sim.pfnWrite = host_write;
+    sim.pvContext = &host;
+
+    // Run up to the next timer event, then raise the due interrupts. Pending
+    // requests wait for EI; the 128us one has priority.
+    for (;;)
+    {
+        qwUntil = qwNext128us < qwNext1ms ? qwNext128us : qwNext1ms;
+        if (qwUntil > qwBudget) qwUntil = qwBudget;
+
+        stop = m8b_sim_run(&sim, qwUntil);
+        if (stop != m8b_sim_budget || sim.qwCycles >= qwBudget)
+            break;
+
+        if (sim.qwCycles >= qwNext128us)
+        {
+            bPending |= INT_128US;
+            qwNext128us += CYCLES_128US;
+        }
+        if (sim.qwCycles >= qwNext1ms)
+        {
+            bPending |= INT_1MS;
+            qwNext1ms += CYCLES_1MS;
+        }
+
+        bEnabled = bPending & sim.rgbIO[PORT_GLOBAL_INT];
+        if (bEnabled & INT_128US)
+        {
+            if (m8b_sim_interrupt(&sim, VEC_TIMER_128US))
+            {
+                bPending &= ~INT_128US;
+                ++nInterrupts;
+            }
+        }
+        else if (bEnabled & INT_1MS)
+        {
+            if (m8b_sim_interrupt(&sim, VEC_TIMER_1MS))
+            {
+                bPending &= ~INT_1MS;
+                ++nInterrupts;
+            }
+        }
+    }
+    dSeconds = std::chrono::duration<double>(clock::now() - tStart).count();
+
+    printf("%s: %s at %04X after %llu cycles (%.3f ms), %llu instructions, %zu interrupts, %zu I/O writes, %.1f MIPS\n",
+           image.strName.c_str(), stop_name(stop), sim.pc,
+           (unsigned long long)sim.qwCycles, sim.qwCycles * 1e3 / CPU_HZ, (unsigned long long)sim.qwInsns,
+           nInterrupts, host.nWrites, dSeconds > 0 ? sim.qwInsns / dSeconds / 1e6 : 0.0);
+
+    return stop != m8b_sim_badop;
+}
+
+int main(int argc, char* argv[])
+{
+    static const char* rgszDefaults[] = { "../examples/logo.hex", "../examples/mouse.hex" };
+    const char** rgszArgs;
+    const char* szCfg = CFG_FILE;
+    size_t cbRAM;
+    double dMillis = 100;
+    bool fTrace = false, fOk = true;
+    int c, nArgs;
+
+    for (c = 1; c < argc && argv[c][0] == '-'; ++c)
+    {
+        if (!strcmp(argv[c], "-v"))
+            fTrace = true;
+        else if (!strcmp(argv[c], "-m") && c + 1 < argc)
+            dMillis = atof(argv[++c]);
+        else if (!strcmp(argv[c], "-c") && c + 1 < argc)
+            szCfg = argv[++c];
+        else
+        {
+            fprintf(stderr, "usage: %s [-v] [-m ms] [-c m8b.cfg] [image.hex ...]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (!read_ram_size(szCfg, &cbRAM))
+        return 1;
+
+    rgszArgs = c < argc ? (const char**)argv + c : rgszDefaults;
+    nArgs = c < argc ? argc - c : (int)(sizeof(rgszDefaults) / sizeof(rgszDefaults[0]));
+    for (c = 0; c < nArgs; ++c)
+        fOk &= run_image(rgszArgs[c], cbRAM, (uint64)(dMillis * (CPU_HZ / 1000)), fTrace);
+
+    return fOk ? 0 : 1;
+}